@@ -0,0 +1,277 @@
+/*
+ * Non-interactive bulk Fibonacci lookups without stdio in the hot path.
+ *
+ *   gcc -O2 fib_batch.c -o fib_batch
+ *   ./fib_batch [--binary-out] input [output]
+ *   ./fib_batch --gen n count file [--binary]     write a test input
+ *
+ * Text input is exactly what problem1.c reads from the keyboard: n, the
+ * number of searches, then the search positions, separated by any
+ * whitespace, so "./problem1 < file" and "./fib_batch file" agree. Binary
+ * input is a fib_bin_hdr followed by count int64 positions. Either kind is
+ * mmap()ed and parsed in place by a hand-written integer parser.
+ *
+ * Results are F(pos) of the n-term table, 64-bit with wrap-around, and -1
+ * for positions outside [0, n] as in search_fib. Text output is one value
+ * per line, formatted two digits at a time into a 1 MiB buffer that goes
+ * out with write(); binary output is the int64 results after a header.
+ * Phase timings go to stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FIB_BIN_MAGIC 0x51424946u   /* "FIBQ" */
+#define OUT_BUF (1u << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;               /* 1 */
+    int64_t n;                      /* last term of the table */
+    uint64_t count;
+} fib_bin_hdr;
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t used;
+} out_buf;
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void fail(const char *what) {
+    perror(what);
+    exit(1);
+}
+
+/* ---------- output ---------- */
+
+void out_flush(out_buf *o) {
+    char *p = o->buf;
+    while (o->used > 0) {
+        ssize_t w = write(o->fd, p, o->used);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) fail("write failed");
+        p += w;
+        o->used -= (size_t)w;
+    }
+}
+
+void out_bytes(out_buf *o, const void *data, size_t n) {
+    if (o->used + n > OUT_BUF) out_flush(o);
+    memcpy(o->buf + o->used, data, n);
+    o->used += n;
+}
+
+const char DIGITS2[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Appends v and a newline; two digits per step, right to left. */
+void out_i64(out_buf *o, int64_t v) {
+    char tmp[24];
+    char *end = tmp + sizeof(tmp), *p = end;
+    *--p = '\n';
+    uint64_t u = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+    while (u >= 100) {
+        unsigned d = (unsigned)(u % 100) * 2;
+        u /= 100;
+        *--p = DIGITS2[d + 1];
+        *--p = DIGITS2[d];
+    }
+    if (u >= 10) {
+        *--p = DIGITS2[u * 2 + 1];
+        *--p = DIGITS2[u * 2];
+    } else {
+        *--p = (char)('0' + u);
+    }
+    if (v < 0) *--p = '-';
+    out_bytes(o, p, (size_t)(end - p));
+}
+
+/* ---------- input ---------- */
+
+/* Parses the next integer at *pp; returns 0 at end of input. Values that
+ * do not fit in int64_t are rejected. */
+int parse_i64(const char **pp, const char *end, int64_t *out) {
+    const char *p = *pp;
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    if (p == end) return 0;
+    int neg = 0;
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+    if (p == end || (unsigned)(*p - '0') > 9) {
+        fprintf(stderr, "bad number in input: '%c'\n", p == end ? ' ' : *p);
+        exit(1);
+    }
+    uint64_t v = 0, limit = neg ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    while (p < end && (unsigned)(*p - '0') <= 9) {
+        unsigned d = (unsigned)(*p++ - '0');
+        if (v > (limit - d) / 10) {
+            fprintf(stderr, "number out of range in input\n");
+            exit(1);
+        }
+        v = v * 10 + d;
+    }
+    *out = neg ? (int64_t)(0 - v) : (int64_t)v;
+    *pp = p;
+    return 1;
+}
+
+/* ---------- table ---------- */
+
+int64_t *build_fib(int64_t n) {
+    int64_t len = n + 1;
+    uint64_t *arr = malloc((size_t)len * sizeof(uint64_t));
+    if (!arr) fail("malloc failed");
+    if (len >= 1) arr[0] = 0;
+    if (len >= 2) arr[1] = 1;
+    for (int64_t i = 2; i < len; i++) arr[i] = arr[i - 1] + arr[i - 2];
+    return (int64_t *)arr;
+}
+
+/* ---------- generator ---------- */
+
+int gen(int64_t n, uint64_t count, const char *path, int binary) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) fail("open output failed");
+    out_buf o = { fd, malloc(OUT_BUF), 0 };
+    if (!o.buf) fail("malloc failed");
+    if (binary) {
+        fib_bin_hdr h = { FIB_BIN_MAGIC, 1, n, count };
+        out_bytes(&o, &h, sizeof(h));
+    } else {
+        out_i64(&o, n);
+        out_i64(&o, (int64_t)count);
+    }
+    uint64_t x = 88172645463325252ull;
+    for (uint64_t i = 0; i < count; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        int64_t pos = (int64_t)(x % (uint64_t)(n + n / 50 + 2)) - (int64_t)((x >> 60) == 0);  /* some misses */
+        if (binary) out_bytes(&o, &pos, sizeof(pos));
+        else out_i64(&o, pos);
+    }
+    out_flush(&o);
+    free(o.buf);
+    close(fd);
+    return 0;
+}
+
+/* ---------- main ---------- */
+
+int main(int argc, char *argv[]) {
+    if (argc >= 5 && strcmp(argv[1], "--gen") == 0)
+        return gen(atoll(argv[2]), strtoull(argv[3], NULL, 10), argv[4], argc > 5 && strcmp(argv[5], "--binary") == 0);
+
+    int arg = 1, binary_out = 0;
+    if (arg < argc && strcmp(argv[arg], "--binary-out") == 0) { binary_out = 1; arg++; }
+    if (arg >= argc) {
+        fprintf(stderr, "usage: %s [--binary-out] input [output]\n       %s --gen n count file [--binary]\n", argv[0], argv[0]);
+        return 1;
+    }
+    const char *in_path = argv[arg], *out_path = arg + 1 < argc ? argv[arg + 1] : NULL;
+
+    double t0 = now_sec();
+    int fd = open(in_path, O_RDONLY);
+    if (fd == -1) fail("open input failed");
+    struct stat st;
+    if (fstat(fd, &st) == -1) fail("fstat failed");
+    if (st.st_size == 0) { fprintf(stderr, "empty input\n"); return 1; }
+    const char *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) fail("mmap failed");
+    close(fd);
+    posix_madvise((void *)map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    /* positions: straight from the mapping for binary, parsed for text */
+    int64_t n;
+    uint64_t count;
+    const int64_t *pos;
+    int64_t *parsed = NULL;
+    const fib_bin_hdr *h = (const fib_bin_hdr *)map;
+    if ((size_t)st.st_size >= sizeof(*h) && h->magic == FIB_BIN_MAGIC) {
+        if (h->version != 1 || h->count > ((uint64_t)st.st_size - sizeof(*h)) / sizeof(int64_t)) {
+            fprintf(stderr, "truncated binary input\n");
+            return 1;
+        }
+        n = h->n;
+        count = h->count;
+        pos = (const int64_t *)(map + sizeof(*h));
+    } else {
+        const char *p = map, *end = map + st.st_size;
+        int64_t s;
+        if (!parse_i64(&p, end, &n) || !parse_i64(&p, end, &s) || s < 0) {
+            fprintf(stderr, "input must start with n and the number of searches\n");
+            return 1;
+        }
+        count = (uint64_t)s;
+        /* every position takes at least two bytes, digit and separator,
+           so a larger count cannot be in the file (or fit in memory) */
+        if (count > (size_t)(end - p) / 2 + 1) {
+            fprintf(stderr, "expected %llu positions, the input is too short\n", (unsigned long long)count);
+            return 1;
+        }
+        parsed = malloc((count ? count : 1) * sizeof(int64_t));
+        if (!parsed) fail("malloc failed");
+        for (uint64_t i = 0; i < count; i++) {
+            if (!parse_i64(&p, end, &parsed[i])) {
+                fprintf(stderr, "expected %llu positions, found %llu\n", (unsigned long long)count, (unsigned long long)i);
+                return 1;
+            }
+        }
+        pos = parsed;
+    }
+    if (n < 0) { fprintf(stderr, "n must not be negative\n"); return 1; }
+    /* the table has n + 1 entries; keep its byte size from wrapping */
+    if ((uint64_t)n >= SIZE_MAX / sizeof(uint64_t) - 1) { fprintf(stderr, "n is too large\n"); return 1; }
+    double t1 = now_sec();
+
+    int64_t *fib = build_fib(n);
+    int64_t *res = malloc((count ? count : 1) * sizeof(int64_t));
+    if (!res) fail("malloc failed");
+    for (uint64_t i = 0; i < count; i++) res[i] = pos[i] < 0 || pos[i] > n ? -1 : fib[pos[i]];
+    double t2 = now_sec();
+
+    int out_fd = out_path ? open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+    if (out_fd == -1) fail("open output failed");
+    out_buf o = { out_fd, malloc(OUT_BUF), 0 };
+    if (!o.buf) fail("malloc failed");
+    if (binary_out) {
+        fib_bin_hdr oh = { FIB_BIN_MAGIC, 1, n, count };
+        out_bytes(&o, &oh, sizeof(oh));
+        out_flush(&o);
+        const char *p = (const char *)res;
+        size_t left = count * sizeof(int64_t);
+        while (left > 0) {
+            ssize_t w = write(out_fd, p, left);
+            if (w == -1 && errno == EINTR) continue;
+            if (w <= 0) fail("write failed");
+            p += w;
+            left -= (size_t)w;
+        }
+    } else {
+        for (uint64_t i = 0; i < count; i++) out_i64(&o, res[i]);
+        out_flush(&o);
+    }
+    if (out_path) close(out_fd);
+    double t3 = now_sec();
+
+    fprintf(stderr, "%llu queries: read %.3f s, compute %.3f s, write %.3f s (%.0f queries/s end to end)\n",
+            (unsigned long long)count, t1 - t0, t2 - t1, t3 - t2, count / (t3 - t0));
+    munmap((void *)map, (size_t)st.st_size);
+    free(parsed);
+    free(fib);
+    free(res);
+    free(o.buf);
+    return 0;
+}
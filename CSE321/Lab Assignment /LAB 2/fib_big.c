@@ -0,0 +1,402 @@
+/*
+ * Arbitrary-precision Fibonacci: F(n) by fast doubling on 64-bit limbs.
+ *
+ *   gcc -O2 fib_big.c -o fib_big -pthread
+ *   ./fib_big n [threads] [--print]    F(n): size, low digits, time
+ *   ./fib_big bench [threads]           fast doubling vs the O(n) loop
+ *
+ * Fast doubling needs O(log n) steps of
+ *   F(2k)   = F(k) * (2F(k+1) - F(k))
+ *   F(2k+1) = F(k)^2 + F(k+1)^2
+ * so the cost is a handful of big multiplications at the final size.
+ * Products use Karatsuba above KARA_MIN limbs and schoolbook below. The
+ * three products of a step, and the three half-size products inside each
+ * Karatsuba level, run on extra threads while spare threads are left.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KARA_MIN 32         /* limbs; below this schoolbook wins */
+#define PAR_MIN 2048        /* limbs; smaller products stay on one thread */
+
+typedef unsigned __int128 u128;
+
+typedef struct {
+    uint64_t *d;
+    size_t n;               /* used limbs, no leading zero limbs */
+    size_t cap;
+} big;
+
+atomic_int spare_threads;
+
+void *xmalloc(size_t n) {
+    void *p = malloc(n ? n : 1);
+    if (!p) { perror("malloc failed"); exit(1); }
+    return p;
+}
+
+void big_reserve(big *x, size_t cap) {
+    if (x->cap >= cap) return;
+    x->d = realloc(x->d, cap * sizeof(uint64_t));
+    if (!x->d) { perror("realloc failed"); exit(1); }
+    x->cap = cap;
+}
+
+void big_trim(big *x) {
+    while (x->n > 0 && x->d[x->n - 1] == 0) x->n--;
+}
+
+/* ---------- limb arithmetic ---------- */
+
+/* r[0..n) = a[0..n) + b[0..n), returns the carry */
+uint64_t add_n(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    uint64_t c = 0;
+    for (size_t i = 0; i < n; i++) {
+        u128 s = (u128)a[i] + b[i] + c;
+        r[i] = (uint64_t)s;
+        c = (uint64_t)(s >> 64);
+    }
+    return c;
+}
+
+/* r[0..rn) += x[0..xn), carrying through r; rn >= xn */
+void add_into(uint64_t *r, size_t rn, const uint64_t *x, size_t xn) {
+    uint64_t c = 0;
+    size_t i = 0;
+    for (; i < xn; i++) {
+        u128 s = (u128)r[i] + x[i] + c;
+        r[i] = (uint64_t)s;
+        c = (uint64_t)(s >> 64);
+    }
+    for (; c && i < rn; i++) c = ++r[i] == 0;
+}
+
+/* r[0..rn) -= x[0..xn), borrowing through r; the result must stay >= 0 */
+void sub_into(uint64_t *r, size_t rn, const uint64_t *x, size_t xn) {
+    uint64_t b = 0;
+    size_t i = 0;
+    for (; i < xn; i++) {
+        uint64_t v = r[i] - x[i] - b;
+        b = (r[i] < x[i]) || (r[i] == x[i] && b);
+        r[i] = v;
+    }
+    for (; b && i < rn; i++) b = r[i]-- == 0;
+}
+
+/* r[0..an+bn) = a * b, schoolbook */
+void mul_base(uint64_t *r, const uint64_t *a, size_t an, const uint64_t *b, size_t bn) {
+    memset(r, 0, (an + bn) * sizeof(uint64_t));
+    for (size_t i = 0; i < an; i++) {
+        uint64_t c = 0;
+        for (size_t j = 0; j < bn; j++) {
+            u128 t = (u128)a[i] * b[j] + r[i + j] + c;
+            r[i + j] = (uint64_t)t;
+            c = (uint64_t)(t >> 64);
+        }
+        r[i + bn] = c;
+    }
+}
+
+/* ---------- Karatsuba ---------- */
+
+void kara(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n);
+
+typedef struct {
+    uint64_t *r;
+    const uint64_t *a, *b;
+    size_t n;
+} kara_job;
+
+void *kara_thread(void *arg) {
+    kara_job *j = arg;
+    kara(j->r, j->a, j->b, j->n);
+    atomic_fetch_add(&spare_threads, 1);
+    return NULL;
+}
+
+/* Runs job on a new thread if one is spare, otherwise right here. */
+int kara_spawn(pthread_t *th, kara_job *j) {
+    if (j->n >= PAR_MIN && atomic_fetch_sub(&spare_threads, 1) > 0) {
+        if (pthread_create(th, NULL, kara_thread, j) == 0) return 1;
+        atomic_fetch_add(&spare_threads, 1);
+    } else if (j->n >= PAR_MIN) {
+        atomic_fetch_add(&spare_threads, 1);
+    }
+    kara(j->r, j->a, j->b, j->n);
+    return 0;
+}
+
+/* r[0..2n) = a[0..n) * b[0..n) */
+void kara(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    if (n < KARA_MIN) { mul_base(r, a, n, b, n); return; }
+    size_t h = n / 2, m = n - h;          /* low and high half sizes, m >= h */
+
+    /* z0 = a0*b0 lands in r[0..2h), z2 = a1*b1 in r[2h..2n) */
+    kara_job j0 = { r, a, b, h }, j2 = { r + 2 * h, a + h, b + h, m };
+    pthread_t t0, t2;
+    int p0 = kara_spawn(&t0, &j0);
+    int p2 = kara_spawn(&t2, &j2);
+
+    /* z1 = (a0 + a1)(b0 + b1) on m + 1 limbs */
+    uint64_t *sa = xmalloc((m + 1) * sizeof(uint64_t));
+    uint64_t *sb = xmalloc((m + 1) * sizeof(uint64_t));
+    uint64_t *z1 = xmalloc(2 * (m + 1) * sizeof(uint64_t));
+    memcpy(sa, a + h, m * sizeof(uint64_t));
+    memcpy(sb, b + h, m * sizeof(uint64_t));
+    sa[m] = 0;
+    sb[m] = 0;
+    add_into(sa, m + 1, a, h);
+    add_into(sb, m + 1, b, h);
+    kara(z1, sa, sb, m + 1);
+
+    if (p0) pthread_join(t0, NULL);
+    if (p2) pthread_join(t2, NULL);
+    sub_into(z1, 2 * (m + 1), r, 2 * h);
+    sub_into(z1, 2 * (m + 1), r + 2 * h, 2 * m);
+
+    /* the top limbs of z1 are zero: the product fits in 2n */
+    size_t zn = 2 * (m + 1);
+    if (zn > 2 * n - h) zn = 2 * n - h;
+    add_into(r + h, 2 * n - h, z1, zn);
+    free(sa);
+    free(sb);
+    free(z1);
+}
+
+/* r = a * b; r must not alias a or b */
+void big_mul(big *r, const big *a, const big *b) {
+    if (a->n == 0 || b->n == 0) { r->n = 0; return; }
+    if (a->n < b->n) { const big *t = a; a = b; b = t; }
+    size_t an = a->n, bn = b->n;
+    big_reserve(r, an + bn);
+    if (bn < KARA_MIN) {
+        mul_base(r->d, a->d, an, b->d, bn);
+    } else if (an <= 2 * bn) {
+        /* zero-extend b and run square Karatsuba on an limbs */
+        uint64_t *bp = xmalloc(an * sizeof(uint64_t));
+        uint64_t *t = xmalloc(2 * an * sizeof(uint64_t));
+        memcpy(bp, b->d, bn * sizeof(uint64_t));
+        memset(bp + bn, 0, (an - bn) * sizeof(uint64_t));
+        kara(t, a->d, bp, an);
+        memcpy(r->d, t, (an + bn) * sizeof(uint64_t));
+        free(bp);
+        free(t);
+    } else {
+        /* unbalanced: multiply b by bn-limb slices of a */
+        uint64_t *t = xmalloc(2 * bn * sizeof(uint64_t));
+        memset(r->d, 0, (an + bn) * sizeof(uint64_t));
+        for (size_t off = 0; off < an; off += bn) {
+            size_t len = an - off < bn ? an - off : bn;
+            if (len == bn) kara(t, a->d + off, b->d, bn);
+            else mul_base(t, b->d, bn, a->d + off, len);
+            add_into(r->d + off, an + bn - off, t, len + bn);
+        }
+        free(t);
+    }
+    r->n = an + bn;
+    big_trim(r);
+}
+
+/* r = a + b; r may alias a or b */
+void big_add(big *r, const big *a, const big *b) {
+    if (a->n < b->n) { const big *t = a; a = b; b = t; }
+    size_t an = a->n, bn = b->n;
+    big_reserve(r, an + 1);
+    uint64_t c = add_n(r->d, a->d, b->d, bn);
+    for (size_t i = bn; i < an; i++) {
+        r->d[i] = a->d[i] + c;
+        c = c && r->d[i] == 0;
+    }
+    r->d[an] = c;
+    r->n = an + 1;
+    big_trim(r);
+}
+
+/* r = a - b for a >= b; r may alias a */
+void big_sub(big *r, const big *a, const big *b) {
+    big_reserve(r, a->n);
+    if (r != a) memcpy(r->d, a->d, a->n * sizeof(uint64_t));
+    r->n = a->n;
+    sub_into(r->d, r->n, b->d, b->n);
+    big_trim(r);
+}
+
+void big_set_u64(big *r, uint64_t v) {
+    big_reserve(r, 1);
+    r->d[0] = v;
+    r->n = v != 0;
+}
+
+/* ---------- Fibonacci ---------- */
+
+typedef struct {
+    big *r;
+    const big *a, *b;
+} mul_job;
+
+void *mul_thread(void *arg) {
+    mul_job *j = arg;
+    big_mul(j->r, j->a, j->b);
+    atomic_fetch_add(&spare_threads, 1);
+    return NULL;
+}
+
+/* F(n) by fast doubling, walking the bits of n from the top */
+void fib_doubling(big *out, uint64_t n) {
+    big a = { 0 }, b = { 0 }, t = { 0 }, c = { 0 }, a2 = { 0 }, b2 = { 0 };
+    big_set_u64(&a, 0);                    /* F(k) */
+    big_set_u64(&b, 1);                    /* F(k+1) */
+    int top = 63;
+    while (top >= 0 && !((n >> top) & 1)) top--;
+    for (int bit = top; bit >= 0; bit--) {
+        big_add(&t, &b, &b);               /* t = 2F(k+1) - F(k) */
+        big_sub(&t, &t, &a);
+
+        mul_job jobs[2] = { { &a2, &a, &a }, { &b2, &b, &b } };
+        pthread_t th[2];
+        int spawned[2] = { 0, 0 };
+        for (int i = 0; i < 2; i++)
+            if (a.n >= PAR_MIN && atomic_fetch_sub(&spare_threads, 1) > 0)
+                spawned[i] = pthread_create(&th[i], NULL, mul_thread, &jobs[i]) == 0;
+            else if (a.n >= PAR_MIN)
+                atomic_fetch_add(&spare_threads, 1);
+        big_mul(&c, &a, &t);               /* F(2k) */
+        for (int i = 0; i < 2; i++) {
+            if (spawned[i]) pthread_join(th[i], NULL);
+            else big_mul(jobs[i].r, jobs[i].a, jobs[i].b);
+        }
+        big_add(&a2, &a2, &b2);            /* F(2k+1) */
+
+        if ((n >> bit) & 1) {
+            big_add(&b, &c, &a2);          /* (F(2k+1), F(2k+2)) */
+            big tmp = a; a = a2; a2 = tmp;
+        } else {
+            big tmp = a; a = c; c = tmp;   /* (F(2k), F(2k+1)) */
+            tmp = b; b = a2; a2 = tmp;
+        }
+    }
+    free(out->d);
+    *out = a;
+    free(b.d);
+    free(t.d);
+    free(c.d);
+    free(a2.d);
+    free(b2.d);
+}
+
+/* F(n) by n big additions, the way build_fib fills its table */
+void fib_linear(big *out, uint64_t n) {
+    size_t limbs = (size_t)(n * 0.6943 / 64) + 2;   /* log2(phi) bits per term */
+    big a = { 0 }, b = { 0 };
+    big_reserve(&a, limbs);
+    big_reserve(&b, limbs);
+    big_set_u64(&a, 0);
+    big_set_u64(&b, 1);
+    for (uint64_t i = 0; i < n; i++) {
+        big_add(&a, &a, &b);               /* (a, b) = (b, a + b) */
+        big tmp = a; a = b; b = tmp;
+    }
+    free(out->d);
+    *out = a;
+    free(b.d);
+}
+
+/* ---------- output ---------- */
+
+uint64_t big_mod(const big *x, uint64_t m) {
+    u128 r = 0;
+    for (size_t i = x->n; i-- > 0;) r = ((r << 64) | x->d[i]) % m;
+    return (uint64_t)r;
+}
+
+/* Full decimal, by repeated division by 10^18; quadratic, for modest n. */
+void big_print(const big *x) {
+    if (x->n == 0) { printf("0\n"); return; }
+    const uint64_t base = 1000000000000000000ull;
+    uint64_t *t = xmalloc(x->n * sizeof(uint64_t));
+    uint64_t *chunks = xmalloc((x->n * 20 / 18 + 2) * sizeof(uint64_t));
+    memcpy(t, x->d, x->n * sizeof(uint64_t));
+    size_t tn = x->n, nc = 0;
+    while (tn > 0) {
+        u128 r = 0;
+        for (size_t i = tn; i-- > 0;) {
+            r = (r << 64) | t[i];
+            t[i] = (uint64_t)(r / base);
+            r %= base;
+        }
+        chunks[nc++] = (uint64_t)r;
+        while (tn > 0 && t[tn - 1] == 0) tn--;
+    }
+    printf("%llu", (unsigned long long)chunks[nc - 1]);
+    for (size_t i = nc - 1; i-- > 0;) printf("%018llu", (unsigned long long)chunks[i]);
+    printf("\n");
+    free(t);
+    free(chunks);
+}
+
+size_t big_bits(const big *x) {
+    if (x->n == 0) return 0;
+    return (x->n - 1) * 64 + (64 - __builtin_clzll(x->d[x->n - 1]));
+}
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int bench(void) {
+    uint64_t ns[] = { 10000, 100000, 1000000, 10000000 };
+    uint64_t linear_max = 1000000;
+    printf("%12s %12s %14s %14s %8s\n", "n", "bits", "doubling s", "linear s", "match");
+    for (int i = 0; i < 4; i++) {
+        big f = { 0 }, g = { 0 };
+        double t0 = now_sec();
+        fib_doubling(&f, ns[i]);
+        double td = now_sec() - t0;
+        if (ns[i] <= linear_max) {
+            t0 = now_sec();
+            fib_linear(&g, ns[i]);
+            double tl = now_sec() - t0;
+            int same = f.n == g.n && memcmp(f.d, g.d, f.n * sizeof(uint64_t)) == 0;
+            printf("%12llu %12zu %14.4f %14.4f %8s\n", (unsigned long long)ns[i], big_bits(&f), td, tl,
+                   same ? "yes" : "NO");
+            if (!same) return 1;
+        } else {
+            printf("%12llu %12zu %14.4f %14s %8s\n", (unsigned long long)ns[i], big_bits(&f), td, "-", "-");
+        }
+        free(f.d);
+        free(g.d);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s n [threads] [--print] | bench [threads]\n", argv[0]);
+        return 1;
+    }
+    long threads = argc > 2 && argv[2][0] != '-' ? atol(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    atomic_store(&spare_threads, (int)threads - 1);
+    if (strcmp(argv[1], "bench") == 0) return bench();
+
+    uint64_t n = strtoull(argv[1], NULL, 10);
+    int print = strcmp(argv[argc - 1], "--print") == 0;
+    big f = { 0 };
+    double t0 = now_sec();
+    fib_doubling(&f, n);
+    double dt = now_sec() - t0;
+    printf("F(%llu): %zu bits, about %.0f digits, %.4f s on %ld thread(s)\n", (unsigned long long)n,
+           big_bits(&f), big_bits(&f) * 0.30103 + 1, dt, threads);
+    printf("last 18 digits: %018llu\n", (unsigned long long)big_mod(&f, 1000000000000000000ull));
+    if (print) big_print(&f);
+    free(f.d);
+    return 0;
+}
@@ -0,0 +1,306 @@
+/*
+ * Fibonacci query service: batches of positions answered by a
+ * work-stealing thread pool.
+ *
+ *   gcc -O2 fib_query.c -o fib_query -pthread
+ *   ./fib_query [table_len] [queries] [max_threads]
+ *
+ * Values are F(pos) mod 2^64, the same wrap-around the int table of
+ * problem1.c has, only 64 bits wide. Positions inside the table are one
+ * load; positions past it (or negative, F(-n) = (-1)^(n+1) F(n)) are
+ * computed by fast doubling in O(log n) instead of answering -1.
+ *
+ * Each worker owns a Chase-Lev deque of query ranges. A worker starts a
+ * batch with its own slice, pops ranges from the bottom and splits them in
+ * half until they fit a grain, pushing the other half for thieves; idle
+ * workers steal from the top of a random victim. Expensive out-of-range
+ * queries therefore spread out instead of stalling one slice.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEQUE_CAP 64        /* a range splits at most 32 times */
+#define GRAIN 4096          /* queries per leaf task */
+#define EMPTY UINT64_MAX
+#define ABORT (UINT64_MAX - 1)
+
+typedef struct {
+    uint64_t *fib;
+    int64_t len;
+} table;
+
+/* ---------- Fibonacci ---------- */
+
+/* F(n) mod 2^64 by fast doubling */
+uint64_t fib_fast(uint64_t n) {
+    uint64_t a = 0, b = 1;
+    for (int bit = 63; bit >= 0; bit--) {
+        uint64_t c = a * (2 * b - a);
+        uint64_t d = a * a + b * b;
+        if ((n >> bit) & 1) { a = d; b = c + d; }
+        else { a = c; b = d; }
+    }
+    return a;
+}
+
+uint64_t answer(const table *t, int64_t pos) {
+    if (pos >= 0 && pos < t->len) return t->fib[pos];
+    if (pos >= 0) return fib_fast((uint64_t)pos);
+    uint64_t n = (uint64_t)0 - (uint64_t)pos;
+    uint64_t v = fib_fast(n);
+    return (n & 1) ? v : (uint64_t)0 - v;
+}
+
+void build_table(table *t, int64_t len) {
+    t->len = len;
+    t->fib = malloc((size_t)len * sizeof(uint64_t));
+    if (!t->fib) { perror("malloc failed"); exit(1); }
+    if (len >= 1) t->fib[0] = 0;
+    if (len >= 2) t->fib[1] = 1;
+    for (int64_t i = 2; i < len; i++) t->fib[i] = t->fib[i - 1] + t->fib[i - 2];
+}
+
+/* ---------- Chase-Lev deque ---------- */
+
+/* A task is the query range [lo, hi), packed as lo << 32 | hi. */
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic uint64_t buf[DEQUE_CAP];
+} deque;
+
+void dq_push(deque *d, uint64_t task) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    atomic_store_explicit(&d->buf[b % DEQUE_CAP], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+uint64_t dq_pop(deque *d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return EMPTY;
+    }
+    uint64_t task = atomic_load_explicit(&d->buf[b % DEQUE_CAP], memory_order_relaxed);
+    if (t == b) {
+        /* last task: race the thieves for it */
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+            task = EMPTY;
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+uint64_t dq_steal(deque *d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return EMPTY;
+    uint64_t task = atomic_load_explicit(&d->buf[t % DEQUE_CAP], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return ABORT;
+    return task;
+}
+
+/* ---------- pool ---------- */
+
+typedef struct pool pool;
+
+typedef struct {
+    pool *p;
+    int id;
+    deque dq;
+    uint64_t stolen;
+} worker;
+
+struct pool {
+    int nthreads;
+    worker *w;
+    pthread_t *th;
+    const table *t;
+    pthread_mutex_t lock;
+    pthread_cond_t start, finish;
+    uint64_t generation;    /* bumped once per batch */
+    int running;            /* workers still inside the current batch */
+    int quit;
+    /* current batch */
+    const int64_t *queries;
+    uint64_t *results;
+    uint64_t count;
+    _Atomic uint64_t done;
+};
+
+void run_range(pool *p, uint64_t lo, uint64_t hi) {
+    for (uint64_t i = lo; i < hi; i++) p->results[i] = answer(p->t, p->queries[i]);
+    atomic_fetch_add_explicit(&p->done, hi - lo, memory_order_release);
+}
+
+/* Splits a range down to GRAIN, leaving the upper halves to thieves. */
+void run_task(worker *w, uint64_t task) {
+    uint64_t lo = task >> 32, hi = task & 0xFFFFFFFFu;
+    while (hi - lo > GRAIN) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        dq_push(&w->dq, mid << 32 | hi);
+        hi = mid;
+    }
+    run_range(w->p, lo, hi);
+}
+
+void work_batch(worker *w) {
+    pool *p = w->p;
+    uint64_t lo = p->count * (uint64_t)w->id / (uint64_t)p->nthreads;
+    uint64_t hi = p->count * (uint64_t)(w->id + 1) / (uint64_t)p->nthreads;
+    unsigned seed = (unsigned)w->id * 2654435761u + 1;
+    if (hi > lo) run_task(w, lo << 32 | hi);
+    while (atomic_load_explicit(&p->done, memory_order_acquire) < p->count) {
+        uint64_t task = dq_pop(&w->dq);
+        if (task == EMPTY && p->nthreads > 1) {
+            seed = seed * 1103515245u + 12345u;
+            int victim = (int)(seed >> 8) % p->nthreads;
+            if (victim != w->id) {
+                task = dq_steal(&p->w[victim].dq);
+                if (task != EMPTY && task != ABORT) w->stolen++;
+            }
+        }
+        if (task == EMPTY || task == ABORT) sched_yield();
+        else run_task(w, task);
+    }
+}
+
+void *worker_main(void *arg) {
+    worker *w = arg;
+    pool *p = w->p;
+    uint64_t seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (!p->quit && p->generation == seen) pthread_cond_wait(&p->start, &p->lock);
+        if (p->quit) { pthread_mutex_unlock(&p->lock); return NULL; }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        work_batch(w);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->running == 0) pthread_cond_signal(&p->finish);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+pool *pool_create(int nthreads, const table *t) {
+    pool *p = calloc(1, sizeof(pool));
+    if (!p) { perror("calloc failed"); exit(1); }
+    p->nthreads = nthreads;
+    p->t = t;
+    p->w = aligned_alloc(64, sizeof(worker) * (size_t)nthreads);
+    p->th = malloc(sizeof(pthread_t) * (size_t)nthreads);
+    if (!p->w || !p->th) { perror("malloc failed"); exit(1); }
+    memset(p->w, 0, sizeof(worker) * (size_t)nthreads);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->finish, NULL);
+    for (int i = 0; i < nthreads; i++) {
+        p->w[i].p = p;
+        p->w[i].id = i;
+        if (pthread_create(&p->th[i], NULL, worker_main, &p->w[i]) != 0) { perror("pthread_create failed"); exit(1); }
+    }
+    return p;
+}
+
+/* Answers queries[0..count) into results; count must stay below 2^32. */
+void pool_run(pool *p, const int64_t *queries, uint64_t *results, uint64_t count) {
+    pthread_mutex_lock(&p->lock);
+    p->queries = queries;
+    p->results = results;
+    p->count = count;
+    atomic_store(&p->done, 0);
+    p->running = p->nthreads;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    while (p->running > 0) pthread_cond_wait(&p->finish, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(pool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->nthreads; i++) pthread_join(p->th[i], NULL);
+    free(p->w);
+    free(p->th);
+    free(p);
+}
+
+/* ---------- benchmark ---------- */
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int64_t len = argc > 1 ? atoll(argv[1]) : 1000000;
+    uint64_t count = argc > 2 ? strtoull(argv[2], NULL, 10) : 20000000;
+    long max_threads = argc > 3 ? atol(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (len < 2 || count < 1 || count >= (1ull << 32) || max_threads < 1) {
+        fprintf(stderr, "usage: %s [table_len>=2] [queries<2^32] [max_threads]\n", argv[0]);
+        return 1;
+    }
+
+    table t;
+    build_table(&t, len);
+    int64_t *queries = malloc(count * sizeof(int64_t));
+    uint64_t *results = malloc(count * sizeof(uint64_t));
+    if (!queries || !results) { perror("malloc failed"); return 1; }
+
+    /* 90% table hits, 9% far past the table, 1% negative */
+    uint64_t x = 88172645463325252ull;
+    for (uint64_t i = 0; i < count; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        unsigned r = (unsigned)(x % 100);
+        if (r < 90) queries[i] = (int64_t)((x >> 8) % (uint64_t)len);
+        else if (r < 99) queries[i] = len + (int64_t)((x >> 8) % (1ull << 40));
+        else queries[i] = -(int64_t)((x >> 8) % (1ull << 20));
+    }
+
+    /* sequential reference */
+    uint64_t expect = 0;
+    double t0 = now_sec();
+    for (uint64_t i = 0; i < count; i++) expect += answer(&t, queries[i]) * (i | 1);
+    double seq = now_sec() - t0;
+    printf("table: %lld entries, queries: %llu\n", (long long)len, (unsigned long long)count);
+    printf("%8s %10s %14s %10s %8s\n", "threads", "seconds", "queries/s", "steals", "check");
+    printf("%8s %10.3f %14.0f %10s %8s\n", "serial", seq, count / seq, "-", "-");
+
+    int ok = 1;
+    for (long n = 1; n <= max_threads; n *= 2) {
+        pool *p = pool_create((int)n, &t);
+        t0 = now_sec();
+        pool_run(p, queries, results, count);
+        double dt = now_sec() - t0;
+        uint64_t got = 0, steals = 0;
+        for (uint64_t i = 0; i < count; i++) got += results[i] * (i | 1);
+        for (int i = 0; i < n; i++) steals += p->w[i].stolen;
+        printf("%8ld %10.3f %14.0f %10llu %8s\n", n, dt, count / dt, (unsigned long long)steals,
+               got == expect ? "ok" : "BAD");
+        if (got != expect) ok = 0;
+        pool_destroy(p);
+    }
+
+    free(t.fib);
+    free(queries);
+    free(results);
+    return ok ? 0 : 1;
+}
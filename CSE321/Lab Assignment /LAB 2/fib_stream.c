@@ -0,0 +1,227 @@
+/*
+ * Streaming Fibonacci: search threads answer positions while the builder
+ * is still filling the table, instead of waiting for pthread_join.
+ *
+ *   gcc -O2 fib_stream.c -o fib_stream -pthread
+ *   ./fib_stream [n] [queries] [search_threads]
+ *
+ * The builder publishes its progress through an atomic high-water mark:
+ * entries [0, ready) are final. It stores ready every PUBLISH_STEP terms
+ * and, only if some searcher is asleep, bumps a futex word and wakes them.
+ * A searcher reads ready with acquire ordering, so a position below it can
+ * be loaded without a lock; for a position above it the searcher spins a
+ * little and then sleeps on the futex.
+ *
+ * Each search thread buckets its queries by position first and walks the
+ * buckets in table order, so it answers whatever is already built and
+ * only ever waits for the next bucket. The program runs the same queries
+ * with build-then-join and with streaming and reports time to first
+ * answer and to last answer for both. Results are F(pos) mod 2^64, and
+ * positions outside [0, n] get -1 as in problem1.c.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define PUBLISH_STEP 4096   /* terms between high-water mark updates */
+#define BUCKETS 4096        /* per-thread position buckets */
+#define SPIN 1000
+
+typedef struct {
+    uint64_t *fib;
+    int64_t len;
+    _Alignas(64) _Atomic int64_t ready;      /* entries [0, ready) are built */
+    _Alignas(64) _Atomic uint32_t seq;       /* futex word, bumped on wake-ups */
+    _Atomic int waiters;
+} stream;
+
+typedef struct {
+    stream *s;
+    const int64_t *queries;
+    uint64_t *results;
+    int64_t lo, hi;         /* this thread's query indices */
+    double start;
+    double first, last;     /* seconds from start */
+} searcher;
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long futex(_Atomic uint32_t *addr, int op, uint32_t val) {
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+/* ---------- builder ---------- */
+
+void publish(stream *s, int64_t ready) {
+    atomic_store(&s->ready, ready);
+    if (atomic_load(&s->waiters) > 0) {
+        atomic_fetch_add(&s->seq, 1);
+        futex(&s->seq, FUTEX_WAKE, INT_MAX);
+    }
+}
+
+void *build_fib(void *arg) {
+    stream *s = arg;
+    uint64_t *f = s->fib;
+    if (s->len >= 1) f[0] = 0;
+    if (s->len >= 2) f[1] = 1;
+    int64_t i = 2;
+    while (i < s->len) {
+        int64_t end = i + PUBLISH_STEP < s->len ? i + PUBLISH_STEP : s->len;
+        for (; i < end; i++) f[i] = f[i - 1] + f[i - 2];
+        publish(s, i);
+    }
+    publish(s, s->len);
+    return NULL;
+}
+
+/* Returns once entries [0, pos] are built. */
+void wait_ready(stream *s, int64_t pos) {
+    if (pos < atomic_load_explicit(&s->ready, memory_order_acquire)) return;
+    for (int i = 0; i < SPIN; i++)
+        if (pos < atomic_load_explicit(&s->ready, memory_order_acquire)) return;
+    atomic_fetch_add(&s->waiters, 1);
+    for (;;) {
+        uint32_t seen = atomic_load(&s->seq);
+        if (pos < atomic_load(&s->ready)) break;
+        futex(&s->seq, FUTEX_WAIT, seen);
+    }
+    atomic_fetch_sub(&s->waiters, 1);
+}
+
+/* ---------- search ---------- */
+
+void *search_fib(void *arg) {
+    searcher *q = arg;
+    stream *s = q->s;
+    int64_t n = q->hi - q->lo;
+    int64_t *order = malloc((size_t)(n > 0 ? n : 1) * sizeof(int64_t));
+    int64_t *start = calloc(BUCKETS + 1, sizeof(int64_t));
+    int64_t *bucket_max = malloc(BUCKETS * sizeof(int64_t));
+    if (!order || !start || !bucket_max) { perror("malloc failed"); exit(1); }
+
+    /* counting sort of the in-range queries by bucket; the rest answer now */
+    int first_done = 0;
+    for (int b = 0; b < BUCKETS; b++) bucket_max[b] = -1;
+    for (int64_t i = q->lo; i < q->hi; i++) {
+        int64_t pos = q->queries[i];
+        if (pos < 0 || pos >= s->len) {
+            q->results[i] = (uint64_t)-1;
+            if (!first_done) { q->first = now_sec() - q->start; first_done = 1; }
+            continue;
+        }
+        int b = (int)((__int128)pos * BUCKETS / s->len);
+        start[b + 1]++;
+        if (pos > bucket_max[b]) bucket_max[b] = pos;
+    }
+    for (int b = 0; b < BUCKETS; b++) start[b + 1] += start[b];
+    int64_t *fill = malloc(BUCKETS * sizeof(int64_t));
+    if (!fill) { perror("malloc failed"); exit(1); }
+    memcpy(fill, start, BUCKETS * sizeof(int64_t));
+    for (int64_t i = q->lo; i < q->hi; i++) {
+        int64_t pos = q->queries[i];
+        if (pos < 0 || pos >= s->len) continue;
+        int b = (int)((__int128)pos * BUCKETS / s->len);
+        order[fill[b]++] = i;
+    }
+
+    for (int b = 0; b < BUCKETS; b++) {
+        if (start[b] == start[b + 1]) continue;
+        wait_ready(s, bucket_max[b]);
+        for (int64_t k = start[b]; k < start[b + 1]; k++) {
+            int64_t i = order[k];
+            q->results[i] = s->fib[q->queries[i]];
+        }
+        if (!first_done) { q->first = now_sec() - q->start; first_done = 1; }
+    }
+    q->last = now_sec() - q->start;
+    free(order);
+    free(start);
+    free(bucket_max);
+    free(fill);
+    return NULL;
+}
+
+/* ---------- benchmark ---------- */
+
+void run(int streaming, int64_t len, const int64_t *queries, uint64_t *results, int64_t count,
+         int threads, double *first, double *last) {
+    stream s;
+    memset(&s, 0, sizeof(s));
+    s.len = len;
+    s.fib = malloc((size_t)len * sizeof(uint64_t));
+    if (!s.fib) { perror("malloc failed"); exit(1); }
+    searcher *q = calloc((size_t)threads, sizeof(searcher));
+    pthread_t *th = malloc((size_t)threads * sizeof(pthread_t));
+    if (!q || !th) { perror("malloc failed"); exit(1); }
+
+    double t0 = now_sec();
+    pthread_t builder;
+    if (pthread_create(&builder, NULL, build_fib, &s) != 0) { perror("pthread_create failed"); exit(1); }
+    if (!streaming) pthread_join(builder, NULL);
+    for (int i = 0; i < threads; i++) {
+        q[i] = (searcher){ &s, queries, results, count * i / threads, count * (i + 1) / threads, t0, 0, 0 };
+        if (pthread_create(&th[i], NULL, search_fib, &q[i]) != 0) { perror("pthread_create failed"); exit(1); }
+    }
+    *first = 1e30;
+    *last = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(th[i], NULL);
+        if (q[i].hi > q[i].lo && q[i].first < *first) *first = q[i].first;
+        if (q[i].last > *last) *last = q[i].last;
+    }
+    if (streaming) pthread_join(builder, NULL);
+    free(s.fib);
+    free(q);
+    free(th);
+}
+
+int main(int argc, char *argv[]) {
+    int64_t n = argc > 1 ? atoll(argv[1]) : 50000000;
+    int64_t count = argc > 2 ? atoll(argv[2]) : 1000000;
+    int threads = argc > 3 ? atoi(argv[3]) : 2;
+    if (n < 0 || count < 1 || threads < 1) {
+        fprintf(stderr, "usage: %s [n] [queries] [search_threads]\n", argv[0]);
+        return 1;
+    }
+    int64_t len = n + 1;
+
+    int64_t *queries = malloc((size_t)count * sizeof(int64_t));
+    uint64_t *joined = malloc((size_t)count * sizeof(uint64_t));
+    uint64_t *streamed = malloc((size_t)count * sizeof(uint64_t));
+    if (!queries || !joined || !streamed) { perror("malloc failed"); return 1; }
+    uint64_t x = 88172645463325252ull;
+    for (int64_t i = 0; i < count; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        queries[i] = (int64_t)(x % (uint64_t)(len + len / 100 + 1));   /* ~1% out of range */
+    }
+
+    double jf, jl, sf, sl;
+    run(0, len, queries, joined, count, threads, &jf, &jl);
+    run(1, len, queries, streamed, count, threads, &sf, &sl);
+
+    printf("n = %lld, %lld queries on %d search thread(s)\n", (long long)n, (long long)count, threads);
+    printf("%-10s %18s %18s\n", "mode", "first answer ms", "last answer ms");
+    printf("%-10s %18.3f %18.3f\n", "join", jf * 1e3, jl * 1e3);
+    printf("%-10s %18.3f %18.3f\n", "stream", sf * 1e3, sl * 1e3);
+    int same = memcmp(joined, streamed, (size_t)count * sizeof(uint64_t)) == 0;
+    printf("results %s\n", same ? "match" : "DIFFER");
+
+    free(queries);
+    free(joined);
+    free(streamed);
+    return same ? 0 : 1;
+}
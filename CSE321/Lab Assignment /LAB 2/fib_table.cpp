@@ -0,0 +1,121 @@
+// Compile-time Fibonacci tables, one per element type.
+//
+//   g++ -O2 -std=c++17 fib_table.cpp -o fib_table
+//   ./fib_table [pos ...]
+//
+// fib_table<T> is a constexpr std::array built by the compiler, so it sits
+// in read-only data and costs nothing at startup; fib<T>(n) is one load.
+//
+//   unsigned types    the table stops at the last term that fits in T
+//                     (47 for uint32_t, 93 for uint64_t, 186 for
+//                     unsigned __int128); asking for more throws, which
+//                     inside a constant expression is a compile error
+//   mod<M>            values mod M; the table holds one Pisano period
+//                     and fib() reduces n by it, so every n is valid
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+
+typedef unsigned __int128 u128;
+
+// Fibonacci numbers modulo M.
+template <uint32_t M>
+struct mod {
+    static_assert(M >= 2, "modulus must be at least 2");
+    uint32_t v;
+    constexpr mod operator+(mod o) const { return mod{static_cast<uint32_t>((uint64_t(v) + o.v) % M)}; }
+    constexpr bool operator==(mod o) const { return v == o.v; }
+};
+
+template <typename T> struct is_mod : std::false_type {};
+template <uint32_t M> struct is_mod<mod<M>> : std::true_type {};
+
+// Largest table compile-time evaluation is asked to build for a modulus.
+constexpr size_t MAX_PERIOD = 1u << 17;
+
+template <typename T>
+constexpr size_t fib_terms() {
+    if constexpr (is_mod<T>::value) {
+        // Pisano period: the first k > 0 with (F(k), F(k+1)) == (0, 1)
+        T a{0}, b{1};
+        for (size_t k = 1; k <= MAX_PERIOD; k++) {
+            T next = a + b;
+            a = b;
+            b = next;
+            if (a == T{0} && b == T{1}) return k;
+        }
+        return 0;
+    } else {
+        static_assert(std::is_unsigned<T>::value || std::is_same<T, u128>::value,
+                      "element type must be unsigned or mod<M>");
+        T a = 0, b = 1;   // F(k), F(k+1)
+        size_t k = 0;
+        while (a <= T(~T(0)) - b) {
+            T next = a + b;
+            a = b;
+            b = next;
+            k++;
+        }
+        return k + 2;     // F(0) .. F(k+1) fit, F(k+2) does not
+    }
+}
+
+template <typename T>
+constexpr std::array<T, fib_terms<T>()> make_table() {
+    static_assert(fib_terms<T>() > 0, "Pisano period of this modulus exceeds MAX_PERIOD");
+    std::array<T, fib_terms<T>()> t{};
+    t[0] = T{0};
+    if (t.size() > 1) t[1] = T{1};
+    for (size_t i = 2; i < t.size(); i++) t[i] = t[i - 1] + t[i - 2];
+    return t;
+}
+
+template <typename T>
+inline constexpr auto fib_table = make_table<T>();
+
+template <typename T>
+constexpr T fib(uint64_t n) {
+    if constexpr (is_mod<T>::value) {
+        return fib_table<T>[n % fib_table<T>.size()];
+    } else {
+        if (n >= fib_table<T>.size()) throw std::out_of_range("Fibonacci term overflows the element type");
+        return fib_table<T>[n];
+    }
+}
+
+// Checked by the compiler; fib<uint64_t>(94) here would not compile.
+static_assert(fib_table<uint32_t>.size() == 48 && fib<uint32_t>(47) == 2971215073u, "uint32_t table");
+static_assert(fib_table<uint64_t>.size() == 94 && fib<uint64_t>(93) == 12200160415121876738ull, "uint64_t table");
+static_assert(fib_table<u128>.size() == 187, "unsigned __int128 table");
+static_assert(fib_table<mod<10>>.size() == 60 && fib<mod<10>>(1000000007).v == 3, "Pisano period of 10");
+static_assert(fib_table<mod<1000>>.size() == 1500, "Pisano period of 1000");
+
+void print_u128(u128 x) {
+    char buf[48];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        buf[--i] = char('0' + int(x % 10));
+        x /= 10;
+    } while (x != 0);
+    std::printf("%s", buf + i);
+}
+
+int main(int argc, char *argv[]) {
+    std::printf("table sizes: uint32_t %zu, uint64_t %zu, __int128 %zu, mod 10 %zu, mod 1000 %zu, mod 65536 %zu\n",
+                fib_table<uint32_t>.size(), fib_table<uint64_t>.size(), fib_table<u128>.size(),
+                fib_table<mod<10>>.size(), fib_table<mod<1000>>.size(), fib_table<mod<65536>>.size());
+
+    for (int i = 1; i < argc; i++) {
+        uint64_t n = std::strtoull(argv[i], nullptr, 10);
+        std::printf("F(%llu):", static_cast<unsigned long long>(n));
+        if (n < fib_table<uint64_t>.size()) std::printf(" %llu", static_cast<unsigned long long>(fib<uint64_t>(n)));
+        else if (n < fib_table<u128>.size()) { std::printf(" "); print_u128(fib<u128>(n)); }
+        else std::printf(" (overflows 128 bits)");
+        std::printf(", mod 1000 = %u, mod 65536 = %u\n", fib<mod<1000>>(n).v, fib<mod<65536>>(n).v);
+    }
+    return 0;
+}
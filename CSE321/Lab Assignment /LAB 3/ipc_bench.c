@@ -0,0 +1,404 @@
+/*
+ * One transport interface over the IPC channels used in this lab, plus a
+ * benchmark to pick between them.
+ *
+ *   gcc -O2 ipc_bench.c -o ipc_bench -lrt
+ *   ./ipc_bench [round_trips] [stream_msgs]
+ *
+ * Every transport implements the same open/send/recv/close table and moves
+ * fixed-size messages in two directions: 0 is parent -> child and 1 is
+ * child -> parent. Implementations:
+ *
+ *   pipe         two pipe() pairs
+ *   sysv-mq      one msgget() queue, the direction is the message type
+ *   posix-mq     two mq_open() queues
+ *   unix-socket  a socketpair(AF_UNIX, SOCK_STREAM)
+ *   shm-futex    a shared-memory ring per direction, futex wakeups
+ *   shm-eventfd  the same rings, eventfd wakeups
+ *
+ * For each payload size the parent forks a child and measures ping-pong
+ * round trips (mean and p99) and one-way streaming (messages per second).
+ * Sizes a transport cannot carry (message queues stop at msgmax) print "-".
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/msg.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define RING_SLOTS 16
+#define SPIN 200                 /* polls before a ring side goes to sleep */
+
+struct shm_ring {
+    _Alignas(64) _Atomic uint32_t head;      /* messages produced */
+    _Alignas(64) _Atomic uint32_t tail;      /* messages consumed */
+    _Alignas(64) _Atomic uint32_t waiting[2];/* 0: consumer on head, 1: producer on tail */
+    size_t slot_size;
+    char data[];                             /* RING_SLOTS slots */
+};
+
+struct chan {
+    int fd[4];                   /* pipe / socket / eventfd descriptors */
+    int qid;                     /* SysV queue */
+    mqd_t mq[2];                 /* POSIX queues */
+    char mq_name[2][64];
+    size_t mq_msgsize;           /* what mq_receive needs, fixed at open */
+    char *mq_buf;                /* POSIX receive buffer of mq_msgsize */
+    struct shm_ring *ring[2];
+    size_t ring_bytes;
+    int use_eventfd;
+    struct { long type; char data[]; } *msg;  /* SysV scratch buffer */
+};
+
+struct transport {
+    const char *name;
+    int (*open)(struct chan *c, size_t max_msg);   /* -1: size not supported */
+    void (*send)(struct chan *c, int dir, const void *buf, size_t n);
+    void (*recv)(struct chan *c, int dir, void *buf, size_t n);
+    void (*close)(struct chan *c);
+};
+
+void fail(const char *what) {
+    perror(what);
+    exit(1);
+}
+
+void write_full(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) fail("write failed");
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+void read_full(int fd, void *buf, size_t n) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r == -1 && errno == EINTR) continue;
+        if (r <= 0) fail("read failed");
+        p += r;
+        n -= (size_t)r;
+    }
+}
+
+/* ---------- pipe ---------- */
+
+int pipe_open(struct chan *c, size_t max_msg) {
+    (void)max_msg;
+    if (pipe(&c->fd[0]) == -1 || pipe(&c->fd[2]) == -1) fail("pipe failed");
+    return 0;
+}
+
+void pipe_send(struct chan *c, int dir, const void *buf, size_t n) {
+    write_full(c->fd[dir * 2 + 1], buf, n);
+}
+
+void pipe_recv(struct chan *c, int dir, void *buf, size_t n) {
+    read_full(c->fd[dir * 2], buf, n);
+}
+
+void pipe_close(struct chan *c) {
+    for (int i = 0; i < 4; i++) close(c->fd[i]);
+}
+
+/* ---------- SysV message queue ---------- */
+
+int sysv_open(struct chan *c, size_t max_msg) {
+    long msgmax = 8192;
+    FILE *f = fopen("/proc/sys/kernel/msgmax", "r");
+    if (f) {
+        if (fscanf(f, "%ld", &msgmax) != 1) msgmax = 8192;
+        fclose(f);
+    }
+    if (max_msg > (size_t)msgmax) return -1;
+    c->qid = msgget(IPC_PRIVATE, IPC_CREAT | 0666);
+    if (c->qid == -1) fail("msgget failed");
+    c->msg = malloc(sizeof(long) + max_msg);
+    if (!c->msg) fail("malloc failed");
+    return 0;
+}
+
+void sysv_send(struct chan *c, int dir, const void *buf, size_t n) {
+    c->msg->type = dir + 1;
+    memcpy(c->msg->data, buf, n);
+    while (msgsnd(c->qid, c->msg, n, 0) == -1)
+        if (errno != EINTR) fail("msgsnd failed");
+}
+
+void sysv_recv(struct chan *c, int dir, void *buf, size_t n) {
+    while (msgrcv(c->qid, c->msg, n, dir + 1, 0) == -1)
+        if (errno != EINTR) fail("msgrcv failed");
+    memcpy(buf, c->msg->data, n);
+}
+
+void sysv_close(struct chan *c) {
+    msgctl(c->qid, IPC_RMID, NULL);
+    free(c->msg);
+}
+
+/* ---------- POSIX message queue ---------- */
+
+int posix_open(struct chan *c, size_t max_msg) {
+    struct mq_attr attr = { 0 };
+    attr.mq_maxmsg = 8;
+    attr.mq_msgsize = (long)max_msg;
+    for (int d = 0; d < 2; d++) {
+        snprintf(c->mq_name[d], sizeof(c->mq_name[d]), "/ipc_bench.%d.%d", (int)getpid(), d);
+        c->mq[d] = mq_open(c->mq_name[d], O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+        if (c->mq[d] == (mqd_t)-1) {
+            if (errno != EINVAL) fail("mq_open failed");
+            if (d == 1) {
+                mq_close(c->mq[0]);
+                mq_unlink(c->mq_name[0]);
+            }
+            return -1;
+        }
+    }
+    /* the kernel may round the size; mq_receive wants at least that much */
+    struct mq_attr got;
+    if (mq_getattr(c->mq[0], &got) == -1) fail("mq_getattr failed");
+    c->mq_msgsize = (size_t)got.mq_msgsize;
+    c->mq_buf = malloc(c->mq_msgsize);
+    if (!c->mq_buf) fail("malloc failed");
+    return 0;
+}
+
+void posix_send(struct chan *c, int dir, const void *buf, size_t n) {
+    while (mq_send(c->mq[dir], buf, n, 0) == -1)
+        if (errno != EINTR) fail("mq_send failed");
+}
+
+void posix_recv(struct chan *c, int dir, void *buf, size_t n) {
+    while (mq_receive(c->mq[dir], c->mq_buf, c->mq_msgsize, NULL) == -1)
+        if (errno != EINTR) fail("mq_receive failed");
+    memcpy(buf, c->mq_buf, n);
+}
+
+void posix_close(struct chan *c) {
+    for (int d = 0; d < 2; d++) {
+        mq_close(c->mq[d]);
+        mq_unlink(c->mq_name[d]);
+    }
+    free(c->mq_buf);
+}
+
+/* ---------- Unix domain socket ---------- */
+
+int unix_open(struct chan *c, size_t max_msg) {
+    (void)max_msg;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, c->fd) == -1) fail("socketpair failed");
+    return 0;
+}
+
+/* fd[0] is the parent's end, fd[1] the child's */
+void unix_send(struct chan *c, int dir, const void *buf, size_t n) {
+    write_full(c->fd[dir], buf, n);
+}
+
+void unix_recv(struct chan *c, int dir, void *buf, size_t n) {
+    read_full(c->fd[1 - dir], buf, n);
+}
+
+void unix_close(struct chan *c) {
+    close(c->fd[0]);
+    close(c->fd[1]);
+}
+
+/* ---------- shared-memory ring ---------- */
+
+long futex(_Atomic uint32_t *addr, int op, uint32_t val) {
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+/* Sleeps until *word moves past seen; which picks the waiter flag. */
+void ring_block(struct chan *c, int dir, int which, _Atomic uint32_t *word, uint32_t seen) {
+    struct shm_ring *r = c->ring[dir];
+    for (int i = 0; i < SPIN; i++)
+        if (atomic_load_explicit(word, memory_order_acquire) != seen) return;
+    atomic_store(&r->waiting[which], 1);
+    if (atomic_load(word) == seen) {
+        if (c->use_eventfd) {
+            uint64_t v;
+            read_full(c->fd[dir * 2 + which], &v, sizeof(v));
+        } else {
+            futex(word, FUTEX_WAIT, seen);
+        }
+    }
+    atomic_store(&r->waiting[which], 0);
+}
+
+void ring_wake(struct chan *c, int dir, int which, _Atomic uint32_t *word) {
+    if (!atomic_load(&c->ring[dir]->waiting[which])) return;
+    if (c->use_eventfd) {
+        uint64_t one = 1;
+        write_full(c->fd[dir * 2 + which], &one, sizeof(one));
+    } else {
+        futex(word, FUTEX_WAKE, 1);
+    }
+}
+
+int ring_open(struct chan *c, size_t max_msg) {
+    c->ring_bytes = sizeof(struct shm_ring) + RING_SLOTS * max_msg;
+    for (int d = 0; d < 2; d++) {
+        c->ring[d] = mmap(NULL, c->ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (c->ring[d] == MAP_FAILED) fail("mmap failed");
+        c->ring[d]->slot_size = max_msg;
+    }
+    if (c->use_eventfd)
+        for (int i = 0; i < 4; i++)
+            if ((c->fd[i] = eventfd(0, 0)) == -1) fail("eventfd failed");
+    return 0;
+}
+
+int ring_open_futex(struct chan *c, size_t max_msg) {
+    c->use_eventfd = 0;
+    return ring_open(c, max_msg);
+}
+
+int ring_open_eventfd(struct chan *c, size_t max_msg) {
+    c->use_eventfd = 1;
+    return ring_open(c, max_msg);
+}
+
+void ring_send(struct chan *c, int dir, const void *buf, size_t n) {
+    struct shm_ring *r = c->ring[dir];
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail;
+    while (head - (tail = atomic_load_explicit(&r->tail, memory_order_acquire)) == RING_SLOTS)
+        ring_block(c, dir, 1, &r->tail, tail);
+    memcpy(r->data + (head % RING_SLOTS) * r->slot_size, buf, n);
+    atomic_store(&r->head, head + 1);
+    ring_wake(c, dir, 0, &r->head);
+}
+
+void ring_recv(struct chan *c, int dir, void *buf, size_t n) {
+    struct shm_ring *r = c->ring[dir];
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    while (atomic_load_explicit(&r->head, memory_order_acquire) == tail)
+        ring_block(c, dir, 0, &r->head, tail);
+    memcpy(buf, r->data + (tail % RING_SLOTS) * r->slot_size, n);
+    atomic_store(&r->tail, tail + 1);
+    ring_wake(c, dir, 1, &r->tail);
+}
+
+void ring_close(struct chan *c) {
+    for (int d = 0; d < 2; d++) munmap(c->ring[d], c->ring_bytes);
+    if (c->use_eventfd)
+        for (int i = 0; i < 4; i++) close(c->fd[i]);
+}
+
+const struct transport transports[] = {
+    { "pipe",        pipe_open,         pipe_send,  pipe_recv,  pipe_close  },
+    { "sysv-mq",     sysv_open,         sysv_send,  sysv_recv,  sysv_close  },
+    { "posix-mq",    posix_open,        posix_send, posix_recv, posix_close },
+    { "unix-socket", unix_open,         unix_send,  unix_recv,  unix_close  },
+    { "shm-futex",   ring_open_futex,   ring_send,  ring_recv,  ring_close  },
+    { "shm-eventfd", ring_open_eventfd, ring_send,  ring_recv,  ring_close  },
+};
+
+/* ---------- benchmark ---------- */
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Returns 0 and fills the results, or -1 if the size is not supported. */
+int run(const struct transport *t, size_t size, int round_trips, int stream,
+        double *mean_us, double *p99_us, double *msgs_per_sec) {
+    struct chan c;
+    memset(&c, 0, sizeof(c));
+    if (t->open(&c, size) == -1) return -1;
+
+    char *buf = calloc(1, size);
+    double *rtt = malloc(sizeof(double) * (size_t)round_trips);
+    if (!buf || !rtt) fail("malloc failed");
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) fail("fork failed");
+    if (pid == 0) {
+        for (int i = 0; i < round_trips; i++) {
+            t->recv(&c, 0, buf, size);
+            t->send(&c, 1, buf, size);
+        }
+        for (int i = 0; i < stream; i++) t->recv(&c, 0, buf, size);
+        t->send(&c, 1, buf, size);
+        exit(0);
+    }
+
+    double total = 0;
+    for (int i = 0; i < round_trips; i++) {
+        double t0 = now_sec();
+        buf[0] = (char)i;
+        t->send(&c, 0, buf, size);
+        t->recv(&c, 1, buf, size);
+        rtt[i] = (now_sec() - t0) * 1e6;
+        total += rtt[i];
+    }
+    double t0 = now_sec();
+    for (int i = 0; i < stream; i++) t->send(&c, 0, buf, size);
+    t->recv(&c, 1, buf, size);
+    double dt = now_sec() - t0;
+    waitpid(pid, NULL, 0);
+
+    qsort(rtt, (size_t)round_trips, sizeof(double), cmp_double);
+    *mean_us = total / round_trips;
+    *p99_us = rtt[(size_t)(round_trips * 0.99)];
+    *msgs_per_sec = stream / dt;
+
+    t->close(&c);
+    free(buf);
+    free(rtt);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int round_trips = argc > 1 ? atoi(argv[1]) : 20000;
+    int stream = argc > 2 ? atoi(argv[2]) : 100000;
+    if (round_trips < 1 || stream < 1) {
+        fprintf(stderr, "usage: %s [round_trips] [stream_msgs]\n", argv[0]);
+        return 1;
+    }
+    size_t sizes[] = { 16, 256, 4096, 8192, 65536 };
+    int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    int ntransports = sizeof(transports) / sizeof(transports[0]);
+
+    printf("%-12s %8s %12s %12s %14s %12s\n", "transport", "bytes", "rtt mean us", "rtt p99 us", "msgs/s", "MB/s");
+    for (int t = 0; t < ntransports; t++) {
+        for (int s = 0; s < nsizes; s++) {
+            double mean, p99, rate;
+            if (run(&transports[t], sizes[s], round_trips, stream, &mean, &p99, &rate) == -1) {
+                printf("%-12s %8zu %12s %12s %14s %12s\n", transports[t].name, sizes[s], "-", "-", "-", "-");
+                continue;
+            }
+            printf("%-12s %8zu %12.2f %12.2f %14.0f %12.1f\n", transports[t].name, sizes[s],
+                   mean, p99, rate, rate * sizes[s] / 1e6);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * OTP store for the login service: random codes, O(1) verification and
+ * timing-wheel expiry in a fixed amount of memory.
+ *
+ *   gcc -O2 otp_store.c -o otp_store
+ *   ./otp_store [capacity_log2] [logins_per_tick] [ttl_ticks] [ticks]
+ *
+ * Codes come from a pool filled by one getrandom() call per POOL_SIZE
+ * codes and are kept as integers, not strings. Each pending OTP is a node
+ * in a fixed array; an open-addressing table (linear probing, backward
+ * shift deletion) maps request id -> node, so issue and verify cost one
+ * hash probe sequence. Nodes are also linked into a hierarchical timing
+ * wheel of WHEEL_LEVELS x WHEEL_SLOTS lists: a tick expires one level-0
+ * slot and, every WHEEL_SLOTS ticks, cascades one slot of the next level
+ * down, so each node is touched at most WHEEL_LEVELS times before it dies.
+ *
+ * Memory is decided up front by the capacity; when every node is in use,
+ * new logins are refused instead of growing the store.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/random.h>
+
+#define POOL_SIZE 4096
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_LEVELS 4            /* covers 2^24 ticks */
+#define MAX_ATTEMPTS 3
+#define NIL UINT32_MAX
+
+enum { OTP_OK = 1, OTP_WRONG = 0, OTP_UNKNOWN = -1 };
+
+struct otp_node {
+    uint64_t id;
+    uint32_t otp;
+    uint32_t expires;             /* tick at which the code dies */
+    uint32_t next, prev;          /* wheel list, or free list through next */
+    uint32_t attempts;
+    uint32_t pad;
+};
+
+struct otp_slot {
+    uint64_t id;                  /* 0 = empty */
+    uint32_t node;
+    uint32_t pad;
+};
+
+struct otp_store {
+    struct otp_node *nodes;
+    struct otp_slot *slots;
+    uint32_t capacity;            /* nodes; the table has twice as many slots */
+    uint64_t slot_mask;
+    uint32_t free_head;
+    uint32_t used;
+    uint32_t now;
+    uint32_t wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint32_t pool[POOL_SIZE];
+    int pool_left;
+    uint64_t expired;
+};
+
+/* ---------- random codes ---------- */
+
+uint32_t otp_random(struct otp_store *s) {
+    for (;;) {
+        if (s->pool_left == 0) {
+            char *p = (char *)s->pool;
+            size_t n = sizeof(s->pool);
+            while (n > 0) {
+                ssize_t r = getrandom(p, n, 0);
+                if (r == -1 && errno == EINTR) continue;
+                if (r <= 0) {
+                    perror("getrandom failed");
+                    exit(1);
+                }
+                p += r;
+                n -= (size_t)r;
+            }
+            s->pool_left = POOL_SIZE;
+        }
+        uint32_t v = s->pool[--s->pool_left];
+        if (v < UINT32_MAX - UINT32_MAX % 900000) return 100000 + v % 900000;  /* unbiased 6 digits */
+    }
+}
+
+/* ---------- id table ---------- */
+
+uint64_t slot_home(struct otp_store *s, uint64_t id) {
+    return (id * 0x9E3779B97F4A7C15ull >> 17) & s->slot_mask;
+}
+
+uint64_t slot_find(struct otp_store *s, uint64_t id) {
+    uint64_t i = slot_home(s, id);
+    while (s->slots[i].id != 0 && s->slots[i].id != id) i = (i + 1) & s->slot_mask;
+    return i;
+}
+
+void slot_erase(struct otp_store *s, uint64_t i) {
+    uint64_t j = i;
+    for (;;) {
+        j = (j + 1) & s->slot_mask;
+        if (s->slots[j].id == 0) break;
+        uint64_t k = slot_home(s, s->slots[j].id);
+        /* move j back into the hole unless its home lies in (i, j] */
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            s->slots[i] = s->slots[j];
+            i = j;
+        }
+    }
+    s->slots[i].id = 0;
+}
+
+/* ---------- timing wheel ---------- */
+
+void wheel_insert(struct otp_store *s, uint32_t n) {
+    uint32_t exp = s->nodes[n].expires;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 &&
+           (exp >> (WHEEL_BITS * level)) - (s->now >> (WHEEL_BITS * level)) >= WHEEL_SLOTS)
+        level++;
+    uint32_t *head = &s->wheel[level][(exp >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    s->nodes[n].prev = NIL;
+    s->nodes[n].next = *head;
+    if (*head != NIL) s->nodes[*head].prev = n;
+    *head = n;
+}
+
+void wheel_remove(struct otp_store *s, uint32_t n) {
+    struct otp_node *node = &s->nodes[n];
+    if (node->next != NIL) s->nodes[node->next].prev = node->prev;
+    if (node->prev != NIL) {
+        s->nodes[node->prev].next = node->next;
+        return;
+    }
+    /* first in its list: find the head that points at it */
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        uint32_t *head = &s->wheel[level][(node->expires >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+        if (*head == n) {
+            *head = node->next;
+            return;
+        }
+    }
+}
+
+void node_free(struct otp_store *s, uint32_t n) {
+    slot_erase(s, slot_find(s, s->nodes[n].id));
+    s->nodes[n].next = s->free_head;
+    s->free_head = n;
+    s->used--;
+}
+
+/* ---------- API ---------- */
+
+int otp_store_init(struct otp_store *s, int capacity_log2) {
+    memset(s, 0, sizeof(*s));
+    s->capacity = 1u << capacity_log2;
+    s->slot_mask = ((uint64_t)s->capacity << 1) - 1;
+    s->nodes = malloc(sizeof(struct otp_node) * s->capacity);
+    s->slots = calloc(s->slot_mask + 1, sizeof(struct otp_slot));
+    if (!s->nodes || !s->slots) return -1;
+    for (uint32_t i = 0; i < s->capacity; i++) s->nodes[i].next = i + 1 < s->capacity ? i + 1 : NIL;
+    memset(s->wheel, 0xFF, sizeof(s->wheel));
+    return 0;
+}
+
+void otp_store_free(struct otp_store *s) {
+    free(s->nodes);
+    free(s->slots);
+}
+
+/* Issues a code for request id (id != 0) valid for ttl ticks; a repeated id
+ * replaces its old code. Returns the code, or 0 if the store is full. */
+uint32_t otp_issue(struct otp_store *s, uint64_t id, uint32_t ttl) {
+    uint64_t i = slot_find(s, id);
+    uint32_t n;
+    if (s->slots[i].id == id) {
+        n = s->slots[i].node;
+        wheel_remove(s, n);
+    } else {
+        if (s->free_head == NIL) return 0;
+        n = s->free_head;
+        s->free_head = s->nodes[n].next;
+        s->used++;
+        s->slots[i].id = id;
+        s->slots[i].node = n;
+    }
+    uint32_t max_ttl = (1u << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    struct otp_node *node = &s->nodes[n];
+    node->id = id;
+    node->otp = otp_random(s);
+    node->expires = s->now + (ttl == 0 ? 1 : ttl > max_ttl ? max_ttl : ttl);
+    node->attempts = 0;
+    wheel_insert(s, n);
+    return node->otp;
+}
+
+/* A correct code is consumed; MAX_ATTEMPTS wrong ones burn the request. */
+int otp_verify(struct otp_store *s, uint64_t id, uint32_t code) {
+    uint64_t i = slot_find(s, id);
+    if (s->slots[i].id != id) return OTP_UNKNOWN;
+    uint32_t n = s->slots[i].node;
+    struct otp_node *node = &s->nodes[n];
+    if (node->otp == code) {
+        wheel_remove(s, n);
+        node_free(s, n);
+        return OTP_OK;
+    }
+    if (++node->attempts >= MAX_ATTEMPTS) {
+        wheel_remove(s, n);
+        node_free(s, n);
+    }
+    return OTP_WRONG;
+}
+
+/* Moves every node of one wheel slot down to where it now belongs. */
+void wheel_cascade(struct otp_store *s, int level) {
+    uint32_t *head = &s->wheel[level][(s->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    uint32_t n = *head;
+    *head = NIL;
+    while (n != NIL) {
+        uint32_t next = s->nodes[n].next;
+        wheel_insert(s, n);
+        n = next;
+    }
+}
+
+void otp_tick(struct otp_store *s) {
+    s->now++;
+    int top = 0;
+    while (top < WHEEL_LEVELS - 1 && (s->now & ((1u << (WHEEL_BITS * (top + 1))) - 1)) == 0) top++;
+    for (int level = top; level >= 1; level--) wheel_cascade(s, level);
+
+    uint32_t *head = &s->wheel[0][s->now & (WHEEL_SLOTS - 1)];
+    uint32_t n = *head;
+    *head = NIL;
+    while (n != NIL) {
+        uint32_t next = s->nodes[n].next;
+        node_free(s, n);
+        s->expired++;
+        n = next;
+    }
+}
+
+/* ---------- benchmark ---------- */
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Every tick issues a batch of logins; half of them verify VERIFY_LAG ticks
+ * later (one in eight with a wrong code first), the rest are left to expire. */
+#define VERIFY_LAG 30
+
+int main(int argc, char *argv[]) {
+    int cap_log2 = argc > 1 ? atoi(argv[1]) : 21;
+    uint32_t rate = argc > 2 ? (uint32_t)atoi(argv[2]) : 10000;
+    uint32_t ttl = argc > 3 ? (uint32_t)atoi(argv[3]) : 200;
+    uint32_t ticks = argc > 4 ? (uint32_t)atoi(argv[4]) : 600;
+    if (cap_log2 < 4 || cap_log2 > 30 || rate < 1 || ttl <= VERIFY_LAG || ticks < 1) {
+        fprintf(stderr, "usage: %s [capacity_log2 4..30] [logins_per_tick] [ttl_ticks > %d] [ticks]\n",
+                argv[0], VERIFY_LAG);
+        return 1;
+    }
+
+    struct otp_store s;
+    if (otp_store_init(&s, cap_log2) == -1) {
+        perror("malloc failed");
+        return 1;
+    }
+    size_t ring = (size_t)rate * (VERIFY_LAG + 1);
+    uint32_t *codes = malloc(sizeof(uint32_t) * ring);   /* what the mail worker would have sent */
+    if (!codes) {
+        perror("malloc failed");
+        return 1;
+    }
+
+    uint64_t issued = 0, refused = 0, ok = 0, wrong = 0, verifies = 0, peak = 0;
+    double t_issue = 0, t_verify = 0, t_tick = 0;
+    uint64_t id = 1;
+    for (uint32_t t = 0; t < ticks; t++) {
+        double t0 = now_sec();
+        for (uint32_t i = 0; i < rate; i++, id++) {
+            uint32_t code = otp_issue(&s, id, ttl);
+            codes[id % ring] = code;
+            if (code) issued++;
+            else refused++;
+        }
+        double t1 = now_sec();
+        if (t >= VERIFY_LAG) {
+            uint64_t first = id - (uint64_t)rate * (VERIFY_LAG + 1);
+            for (uint64_t v = first; v < first + rate; v += 2) {
+                uint32_t code = codes[v % ring];
+                if (code == 0) continue;
+                if ((v & 15) == 1) {
+                    otp_verify(&s, v, code == 999999 ? 100000 : code + 1);
+                    verifies++;
+                }
+                int r = otp_verify(&s, v, code);
+                verifies++;
+                if (r == OTP_OK) ok++;
+                else wrong++;
+            }
+        }
+        double t2 = now_sec();
+        otp_tick(&s);
+        double t3 = now_sec();
+        t_issue += t1 - t0;
+        t_verify += t2 - t1;
+        t_tick += t3 - t2;
+        if (s.used > peak) peak = s.used;
+    }
+
+    size_t bytes = sizeof(struct otp_node) * s.capacity + sizeof(struct otp_slot) * (s.slot_mask + 1);
+    printf("capacity: %u codes, %.1f MB fixed\n", s.capacity, bytes / 1e6);
+    printf("issued: %llu, refused (full): %llu, peak outstanding: %llu\n",
+           (unsigned long long)issued, (unsigned long long)refused, (unsigned long long)peak);
+    printf("verified: %llu ok, %llu failed; expired: %llu; still pending: %u\n",
+           (unsigned long long)ok, (unsigned long long)wrong, (unsigned long long)s.expired, s.used);
+    printf("issue:  %12.0f /s\n", issued / t_issue);
+    printf("verify: %12.0f /s\n", verifies / t_verify);
+    printf("tick:   %12.1f us mean, %.1f ns per expired code\n",
+           t_tick / ticks * 1e6, s.expired ? t_tick / s.expired * 1e9 : 0.0);
+
+    free(codes);
+    otp_store_free(&s);
+    return wrong != 0;
+}
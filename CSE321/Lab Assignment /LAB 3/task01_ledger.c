@@ -0,0 +1,246 @@
+/*
+ * Sharded multi-account ledger in SysV shared memory.
+ *
+ *   gcc -O2 task01_ledger.c -o task01_ledger
+ *   ./task01_ledger [accounts] [max_procs] [ops_per_proc] [read_pct] [locked]
+ *
+ * Every account has a 64-bit balance. Accounts are spread over NSHARDS
+ * shards (account i lives in shard i % NSHARDS); each shard has a spinlock
+ * that writers take and a sequence counter that makes balance checks
+ * lock-free: a writer bumps the counter to odd before touching a balance
+ * and back to even afterwards, and a reader retries whenever it saw an odd
+ * value or the value changed under it. Readers never write shared memory,
+ * so checks scale with cores instead of bouncing a lock's cache line.
+ *
+ * A transfer locks both shards in index order and bumps both counters, so
+ * no reader and no other writer can see money in flight.
+ *
+ * The benchmark forks 1, 2, 4, ... processes that run a random mix of
+ * checks, deposits and transfers, then checks that the total money equals
+ * the initial total plus all deposits. Passing "locked" as the last
+ * argument makes checks take the shard lock too, for comparison.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+
+#define NSHARDS 4096             /* power of two */
+#define START_BALANCE 1000
+
+struct shard {
+    _Alignas(64) _Atomic uint32_t lock;
+    _Atomic uint32_t seq;
+};
+
+struct ledger {
+    uint64_t accounts;
+    struct shard shards[NSHARDS];
+    _Atomic int64_t balance[];   /* one per account */
+};
+
+struct shard *shard_of(struct ledger *l, uint64_t acct) {
+    return &l->shards[acct & (NSHARDS - 1)];
+}
+
+void shard_lock(struct shard *s) {
+    int spins = 0;
+    for (;;) {
+        if (!atomic_exchange_explicit(&s->lock, 1, memory_order_acquire)) return;
+        while (atomic_load_explicit(&s->lock, memory_order_relaxed))
+            if (++spins > 64) sched_yield();
+    }
+}
+
+void shard_unlock(struct shard *s) {
+    atomic_store_explicit(&s->lock, 0, memory_order_release);
+}
+
+/* Writer side of the seqlock; called with the shard lock held. */
+void write_begin(struct shard *s) {
+    atomic_store_explicit(&s->seq, atomic_load_explicit(&s->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void write_end(struct shard *s) {
+    atomic_store_explicit(&s->seq, atomic_load_explicit(&s->seq, memory_order_relaxed) + 1, memory_order_release);
+}
+
+int64_t ledger_check(struct ledger *l, uint64_t acct) {
+    struct shard *s = shard_of(l, acct);
+    uint32_t s1, s2;
+    int64_t v;
+    do {
+        s1 = atomic_load_explicit(&s->seq, memory_order_acquire);
+        v = atomic_load_explicit(&l->balance[acct], memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+    return v;
+}
+
+int64_t ledger_check_locked(struct ledger *l, uint64_t acct) {
+    struct shard *s = shard_of(l, acct);
+    shard_lock(s);
+    int64_t v = atomic_load_explicit(&l->balance[acct], memory_order_relaxed);
+    shard_unlock(s);
+    return v;
+}
+
+void ledger_deposit(struct ledger *l, uint64_t acct, int64_t amount) {
+    struct shard *s = shard_of(l, acct);
+    shard_lock(s);
+    write_begin(s);
+    atomic_store_explicit(&l->balance[acct],
+                          atomic_load_explicit(&l->balance[acct], memory_order_relaxed) + amount,
+                          memory_order_relaxed);
+    write_end(s);
+    shard_unlock(s);
+}
+
+/* Moves amount from one account to another if the source can cover it;
+ * returns 1 on success. */
+int ledger_transfer(struct ledger *l, uint64_t from, uint64_t to, int64_t amount) {
+    struct shard *a = shard_of(l, from), *b = shard_of(l, to);
+    if (a > b) { struct shard *t = a; a = b; b = t; }
+    shard_lock(a);
+    if (b != a) shard_lock(b);
+
+    int ok = 0;
+    int64_t src = atomic_load_explicit(&l->balance[from], memory_order_relaxed);
+    if (from != to && amount > 0 && src >= amount) {
+        write_begin(a);
+        if (b != a) write_begin(b);
+        atomic_store_explicit(&l->balance[from], src - amount, memory_order_relaxed);
+        atomic_store_explicit(&l->balance[to],
+                              atomic_load_explicit(&l->balance[to], memory_order_relaxed) + amount,
+                              memory_order_relaxed);
+        if (b != a) write_end(b);
+        write_end(a);
+        ok = 1;
+    }
+
+    if (b != a) shard_unlock(b);
+    shard_unlock(a);
+    return ok;
+}
+
+uint64_t xorshift64(uint64_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int64_t ledger_total(struct ledger *l) {
+    int64_t t = 0;
+    for (uint64_t i = 0; i < l->accounts; i++) t += ledger_check(l, i);
+    return t;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t accounts = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    int max_procs = argc > 2 ? atoi(argv[2]) : 8;
+    long ops = argc > 3 ? atol(argv[3]) : 2000000;
+    int read_pct = argc > 4 ? atoi(argv[4]) : 95;
+    int locked = argc > 5 && strcmp(argv[5], "locked") == 0;
+    if (accounts < 2 || max_procs < 1 || ops < 1 || read_pct < 0 || read_pct > 100) {
+        fprintf(stderr, "usage: %s [accounts>=2] [max_procs] [ops_per_proc] [read_pct 0..100] [locked]\n", argv[0]);
+        return 1;
+    }
+
+    size_t size = sizeof(struct ledger) + accounts * sizeof(_Atomic int64_t);
+    int shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0666);
+    if (shmid == -1) {
+        perror("shmget failed");
+        exit(1);
+    }
+    struct ledger *l = (struct ledger *)shmat(shmid, NULL, 0);
+    if (l == (void *)-1) {
+        perror("shmat failed");
+        exit(1);
+    }
+    shmctl(shmid, IPC_RMID, NULL);   /* freed once the last process detaches */
+    memset(l, 0, sizeof(struct ledger));
+    l->accounts = accounts;
+    for (uint64_t i = 0; i < accounts; i++) atomic_init(&l->balance[i], START_BALANCE);
+
+    int net_pipe[2];
+    if (pipe(net_pipe) == -1) {
+        perror("pipe failed");
+        exit(1);
+    }
+
+    printf("accounts: %llu, shards: %d, ops per process: %ld, checks: %d%%%s\n",
+           (unsigned long long)accounts, NSHARDS, ops, read_pct, locked ? " (locked)" : " (seqlock)");
+    printf("%6s %10s %14s %14s\n", "procs", "seconds", "ops/s", "checks/s");
+    int ok = 1;
+    for (int n = 1; n <= max_procs; n *= 2) {
+        int64_t before = ledger_total(l);
+        fflush(stdout);
+        double t0 = now_sec();
+        for (int p = 0; p < n; p++) {
+            pid_t pid = fork();
+            if (pid == -1) {
+                perror("fork failed");
+                exit(1);
+            }
+            if (pid == 0) {
+                uint64_t x = 0x9E3779B97F4A7C15ull ^ ((uint64_t)getpid() << 17);
+                int64_t deposited = 0, sink = 0;
+                for (long i = 0; i < ops; i++) {
+                    uint64_t r = xorshift64(&x);
+                    uint64_t a = (r >> 8) % accounts;
+                    if ((int)(r % 100) < read_pct) {
+                        sink += locked ? ledger_check_locked(l, a) : ledger_check(l, a);
+                    } else if (r & 0x80) {
+                        ledger_transfer(l, a, xorshift64(&x) % accounts, 1 + (int64_t)(r >> 56) % 50);
+                    } else {
+                        ledger_deposit(l, a, 10);
+                        deposited += 10;
+                    }
+                }
+                /* sink goes to the parent too, so the checks cannot be optimised away */
+                int64_t report[2] = { deposited, sink };
+                write(net_pipe[1], report, sizeof(report));
+                shmdt(l);
+                exit(0);
+            }
+        }
+        int64_t deposited = 0;
+        for (int p = 0; p < n; p++) {
+            int64_t report[2];
+            if (read(net_pipe[0], report, sizeof(report)) != sizeof(report)) {
+                perror("read failed");
+                exit(1);
+            }
+            deposited += report[0];
+        }
+        for (int p = 0; p < n; p++) wait(NULL);
+        double dt = now_sec() - t0;
+
+        int64_t after = ledger_total(l);
+        double total_ops = (double)n * ops;
+        printf("%6d %10.4f %14.0f %14.0f%s\n", n, dt, total_ops / dt, total_ops * read_pct / 100.0 / dt,
+               after == before + deposited ? "" : "  MONEY NOT CONSERVED");
+        if (after != before + deposited) ok = 0;
+    }
+
+    close(net_pipe[0]);
+    close(net_pipe[1]);
+    shmdt(l);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+/*
+ * Persistent bank ledger: account state in a memory-mapped file plus an
+ * append-only redo log, so balances survive restarts and crashes.
+ *
+ *   gcc -O2 task01_persist.c -o task01_persist
+ *   ./task01_persist [dir]              interactive a/w/t/c/q menu
+ *   ./task01_persist [dir] bench [tx]   group-commit throughput
+ *
+ * <dir>/bank.dat holds a header and one int64 balance per account; it is
+ * mapped MAP_SHARED and only ever holds committed values. <dir>/bank.log
+ * holds redo records that carry the new balance of every account a
+ * transaction touched, so replaying a record twice is harmless.
+ *
+ * A transaction is buffered, and a batch of them is written to the log
+ * with one write() and one fdatasync(); only then are the new balances
+ * stored into the mapping. Once the log grows past CHECKPOINT_RECS the
+ * mapping is msync()ed, the header records the last applied LSN and the
+ * log is truncated; a clean shutdown does the same. Startup maps the
+ * file and replays just the records past that LSN, stopping at the first
+ * torn or corrupt one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define LEDGER_MAGIC 0x5244474Cu   /* "LGDR" */
+#define ACCOUNTS 1024
+#define START_BALANCE 1000
+#define HEADER_SIZE 4096           /* keeps the balances page aligned */
+#define GROUP_MAX 256              /* transactions per log write */
+#define CHECKPOINT_RECS 65536      /* log records before the log is folded in */
+
+struct ledger_hdr {
+    uint32_t magic;
+    uint32_t accounts;
+    uint64_t applied_lsn;          /* every record up to here is in the file */
+};
+
+struct update {
+    uint32_t account;
+    uint32_t pad;
+    int64_t balance;               /* new value, not a delta */
+};
+
+struct log_rec {
+    uint64_t lsn;
+    uint32_t count;                /* updates used, 1 or 2 */
+    uint32_t crc;                  /* crc32 of the record with crc = 0 */
+    struct update upd[2];
+};
+
+struct ledger {
+    int data_fd, log_fd;
+    struct ledger_hdr *hdr;
+    int64_t *balance;
+    size_t map_size;
+    uint64_t next_lsn;
+    uint64_t log_recs;             /* records currently in the log */
+    struct log_rec pending[GROUP_MAX];
+    int npending;
+    uint64_t syncs;
+};
+
+uint32_t crc_table[256];
+
+void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int j = 0; j < 8; j++) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        crc_table[i] = c;
+    }
+}
+
+uint32_t crc32(const void *data, size_t n) {
+    const uint8_t *p = data;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; i++) c = crc_table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+uint32_t rec_crc(struct log_rec r) {
+    r.crc = 0;
+    return crc32(&r, sizeof(r));
+}
+
+void fail(const char *what) {
+    perror(what);
+    exit(1);
+}
+
+/* ---------- recovery ---------- */
+
+void ledger_open(struct ledger *l, const char *dir) {
+    char path[4096];
+    memset(l, 0, sizeof(*l));
+    l->map_size = HEADER_SIZE + (size_t)ACCOUNTS * sizeof(int64_t);
+
+    snprintf(path, sizeof(path), "%s/bank.dat", dir);
+    l->data_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (l->data_fd == -1) fail("open bank.dat failed");
+    struct stat st;
+    if (fstat(l->data_fd, &st) == -1) fail("fstat failed");
+    int fresh = st.st_size == 0;
+    if (fresh && ftruncate(l->data_fd, (off_t)l->map_size) == -1) fail("ftruncate failed");
+    if (!fresh && (size_t)st.st_size != l->map_size) {
+        fprintf(stderr, "%s has the wrong size\n", path);
+        exit(1);
+    }
+
+    void *map = mmap(NULL, l->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, l->data_fd, 0);
+    if (map == MAP_FAILED) fail("mmap failed");
+    l->hdr = map;
+    l->balance = (int64_t *)((char *)map + HEADER_SIZE);
+
+    if (fresh) {
+        for (int i = 0; i < ACCOUNTS; i++) l->balance[i] = START_BALANCE;
+        l->hdr->accounts = ACCOUNTS;
+        l->hdr->applied_lsn = 0;
+        l->hdr->magic = LEDGER_MAGIC;
+        if (msync(map, l->map_size, MS_SYNC) == -1) fail("msync failed");
+    } else if (l->hdr->magic != LEDGER_MAGIC || l->hdr->accounts != ACCOUNTS) {
+        fprintf(stderr, "%s is not a ledger file\n", path);
+        exit(1);
+    }
+
+    snprintf(path, sizeof(path), "%s/bank.log", dir);
+    l->log_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (l->log_fd == -1) fail("open bank.log failed");
+
+    /* Replay the tail; the first short or corrupt record ends the log. */
+    uint64_t last = l->hdr->applied_lsn, replayed = 0, valid = 0;
+    struct log_rec r;
+    while (pread(l->log_fd, &r, sizeof(r), (off_t)(valid * sizeof(r))) == sizeof(r)) {
+        if (r.crc != rec_crc(r) || r.count < 1 || r.count > 2) break;
+        int ok = 1;
+        for (uint32_t u = 0; u < r.count; u++)
+            if (r.upd[u].account >= ACCOUNTS) ok = 0;
+        if (!ok) break;
+        if (r.lsn > l->hdr->applied_lsn) {
+            for (uint32_t u = 0; u < r.count; u++) l->balance[r.upd[u].account] = r.upd[u].balance;
+            replayed++;
+        }
+        if (r.lsn > last) last = r.lsn;
+        valid++;
+    }
+    if (ftruncate(l->log_fd, (off_t)(valid * sizeof(r))) == -1) fail("ftruncate log failed");
+    l->log_recs = valid;
+    l->next_lsn = last + 1;
+    if (valid || replayed)
+        printf("Recovered: %llu log record(s), %llu replayed\n",
+               (unsigned long long)valid, (unsigned long long)replayed);
+}
+
+/* ---------- commit ---------- */
+
+/* Latest balance, including transactions still waiting in the batch. */
+int64_t ledger_get(struct ledger *l, uint32_t acct) {
+    for (int i = l->npending - 1; i >= 0; i--)
+        for (uint32_t u = 0; u < l->pending[i].count; u++)
+            if (l->pending[i].upd[u].account == acct) return l->pending[i].upd[u].balance;
+    return l->balance[acct];
+}
+
+void ledger_checkpoint(struct ledger *l) {
+    if (msync(l->hdr, l->map_size, MS_SYNC) == -1) fail("msync failed");
+    l->hdr->applied_lsn = l->next_lsn - 1;
+    if (msync(l->hdr, HEADER_SIZE, MS_SYNC) == -1) fail("msync failed");
+    if (ftruncate(l->log_fd, 0) == -1) fail("ftruncate log failed");
+    if (fdatasync(l->log_fd) == -1) fail("fdatasync failed");
+    l->log_recs = 0;
+    l->syncs += 3;
+}
+
+/* Makes the batch durable, then lets it reach the mapped file. */
+void ledger_commit(struct ledger *l) {
+    if (l->npending == 0) return;
+    size_t n = (size_t)l->npending * sizeof(struct log_rec);
+    const char *p = (const char *)l->pending;
+    while (n > 0) {
+        ssize_t w = write(l->log_fd, p, n);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) fail("write log failed");
+        p += w;
+        n -= (size_t)w;
+    }
+    if (fdatasync(l->log_fd) == -1) fail("fdatasync failed");
+    l->syncs++;
+
+    for (int i = 0; i < l->npending; i++)
+        for (uint32_t u = 0; u < l->pending[i].count; u++)
+            l->balance[l->pending[i].upd[u].account] = l->pending[i].upd[u].balance;
+    l->log_recs += (uint64_t)l->npending;
+    l->npending = 0;
+    if (l->log_recs >= CHECKPOINT_RECS) ledger_checkpoint(l);
+}
+
+void ledger_log(struct ledger *l, uint32_t count, struct update a, struct update b) {
+    if (l->npending == GROUP_MAX) ledger_commit(l);
+    struct log_rec *r = &l->pending[l->npending++];
+    memset(r, 0, sizeof(*r));
+    r->lsn = l->next_lsn++;
+    r->count = count;
+    r->upd[0] = a;
+    r->upd[1] = b;
+    r->crc = rec_crc(*r);
+}
+
+int ledger_deposit(struct ledger *l, uint32_t acct, int64_t amount) {
+    if (acct >= ACCOUNTS || amount <= 0) return 0;
+    struct update a = { acct, 0, ledger_get(l, acct) + amount }, none = { 0, 0, 0 };
+    ledger_log(l, 1, a, none);
+    return 1;
+}
+
+int ledger_withdraw(struct ledger *l, uint32_t acct, int64_t amount) {
+    if (acct >= ACCOUNTS || amount <= 0 || amount > ledger_get(l, acct)) return 0;
+    struct update a = { acct, 0, ledger_get(l, acct) - amount }, none = { 0, 0, 0 };
+    ledger_log(l, 1, a, none);
+    return 1;
+}
+
+int ledger_transfer(struct ledger *l, uint32_t from, uint32_t to, int64_t amount) {
+    if (from >= ACCOUNTS || to >= ACCOUNTS || from == to || amount <= 0) return 0;
+    int64_t src = ledger_get(l, from);
+    if (amount > src) return 0;
+    struct update a = { from, 0, src - amount }, b = { to, 0, ledger_get(l, to) + amount };
+    ledger_log(l, 2, a, b);
+    return 1;
+}
+
+/* A clean shutdown folds the log in, so the next start replays nothing. */
+void ledger_close(struct ledger *l) {
+    ledger_commit(l);
+    if (l->log_recs > 0) ledger_checkpoint(l);
+    munmap(l->hdr, l->map_size);
+    close(l->log_fd);
+    close(l->data_fd);
+}
+
+int64_t ledger_total(struct ledger *l) {
+    int64_t t = 0;
+    for (uint32_t i = 0; i < ACCOUNTS; i++) t += ledger_get(l, i);
+    return t;
+}
+
+/* ---------- benchmark ---------- */
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+uint64_t xorshift64(uint64_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+/* Transfers only, so the total must never change. */
+void run_transfers(struct ledger *l, long tx, int group, uint64_t seed) {
+    uint64_t x = seed | 1;
+    for (long i = 0; i < tx; i++) {
+        uint64_t r = xorshift64(&x);
+        ledger_transfer(l, (uint32_t)(r % ACCOUNTS), (uint32_t)((r >> 20) % ACCOUNTS), 1 + (int64_t)(r >> 40) % 100);
+        if ((i + 1) % group == 0) ledger_commit(l);
+    }
+    ledger_commit(l);
+}
+
+int bench(const char *dir, long tx) {
+    struct ledger l;
+    ledger_open(&l, dir);
+    int64_t total = ledger_total(&l);
+    printf("%6s %10s %12s %10s\n", "group", "seconds", "tx/s", "syncs");
+    int groups[] = { 1, 8, 64, GROUP_MAX };
+    for (int g = 0; g < 4; g++) {
+        uint64_t syncs = l.syncs;
+        double t0 = now_sec();
+        run_transfers(&l, tx, groups[g], (uint64_t)(g + 1) * 0x9E3779B97F4A7C15ull);
+        double dt = now_sec() - t0;
+        printf("%6d %10.4f %12.0f %10llu\n", groups[g], dt, tx / dt, (unsigned long long)(l.syncs - syncs));
+    }
+    ledger_close(&l);
+
+    /* Kill a writer mid-batch and check recovery keeps the books balanced. */
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) fail("fork failed");
+    if (pid == 0) {
+        ledger_open(&l, dir);
+        run_transfers(&l, 1L << 40, 16, 0x2545F4914F6CDD1Dull);
+        exit(0);
+    }
+    usleep(200000);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    double t0 = now_sec();
+    ledger_open(&l, dir);
+    double dt = now_sec() - t0;
+    int64_t after = ledger_total(&l);
+    printf("Restart after kill: %.4f s, total %lld (%s)\n", dt, (long long)after,
+           after == total ? "conserved" : "MONEY NOT CONSERVED");
+    ledger_close(&l);
+    return after == total ? 0 : 1;
+}
+
+/* ---------- interactive ---------- */
+
+int main(int argc, char *argv[]) {
+    const char *dir = argc > 1 ? argv[1] : ".";
+    crc32_init();
+    if (argc > 2 && strcmp(argv[2], "bench") == 0) return bench(dir, argc > 3 ? atol(argv[3]) : 20000);
+
+    struct ledger l;
+    ledger_open(&l, dir);
+
+    char option[100];
+    for (;;) {
+        printf("Provide Your Input From Given Options:\n");
+        printf("1. Type a to Add Money\n");
+        printf("2. Type w to Withdraw Money\n");
+        printf("3. Type t to Transfer Money\n");
+        printf("4. Type c to Check Balance\n");
+        printf("5. Type q to Quit\n");
+        if (scanf("%99s", option) != 1 || option[0] == 'q') break;
+
+        unsigned acct, to;
+        long long amount;
+        if (option[0] == 'c') {
+            printf("Enter account number (0-%d):\n", ACCOUNTS - 1);
+            if (scanf("%u", &acct) == 1 && acct < ACCOUNTS)
+                printf("Your current balance is:\n%lld\n", (long long)ledger_get(&l, acct));
+            else
+                printf("Invalid account\n");
+        } else if (option[0] == 'a' || option[0] == 'w') {
+            printf("Enter account number and amount:\n");
+            if (scanf("%u %lld", &acct, &amount) != 2) break;
+            int ok = option[0] == 'a' ? ledger_deposit(&l, acct, amount) : ledger_withdraw(&l, acct, amount);
+            ledger_commit(&l);
+            if (ok)
+                printf("Done, updated balance:\n%lld\n", (long long)ledger_get(&l, acct));
+            else
+                printf("Failed, invalid account or amount\n");
+        } else if (option[0] == 't') {
+            printf("Enter source account, destination account and amount:\n");
+            if (scanf("%u %u %lld", &acct, &to, &amount) != 3) break;
+            int ok = ledger_transfer(&l, acct, to, amount);
+            ledger_commit(&l);
+            printf(ok ? "Transfer successful\n" : "Transfer failed, invalid accounts or amount\n");
+        } else {
+            printf("Invalid selection\n");
+        }
+    }
+
+    ledger_close(&l);
+    printf("Thank you for using\n");
+    return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * Long-running version of task01: one shared-memory bank served to many
+ * client processes.
+ *
+ *   gcc -O2 task01_server.c -o task01_server
+ *   ./task01_server                      interactive (a / w / c, q to quit)
+ *   ./task01_server bench [max_clients] [tx_per_client] [servers]
+ *
+ * Clients push requests into a bounded lock-free MPMC ring that lives in
+ * the SysV segment; server processes pop them and apply them to a balance
+ * that is only ever changed with atomic read-modify-write, so concurrent
+ * deposits and withdrawals cannot lose each other's updates. Each client
+ * gets its reply in its own cache-line-sized slot.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+
+#define RING_SIZE 1024           /* power of two */
+#define MAX_CLIENTS 64
+#define MAX_SERVERS 8
+#define START_BALANCE 1000
+
+enum { ST_OK = 0, ST_INVALID, ST_INSUFFICIENT };
+
+struct request {
+    char option;                 /* 'a', 'w', 'c', or 'q' to stop a server */
+    int client;
+    int64_t amount;
+    uint64_t seq;                /* echoed back so the client can match its reply */
+};
+
+struct cell {
+    _Atomic uint64_t seq;
+    struct request req;
+};
+
+struct reply {
+    _Atomic uint64_t seq;
+    int status;
+    int64_t balance;
+    char pad[40];
+};
+
+struct bankData {
+    _Alignas(64) _Atomic int64_t balance;
+    _Alignas(64) _Atomic uint64_t tail;      /* producers (clients) */
+    _Alignas(64) _Atomic uint64_t head;      /* consumers (servers) */
+    _Alignas(64) struct cell ring[RING_SIZE];
+    struct reply replies[MAX_CLIENTS];
+};
+
+/* Vyukov's bounded MPMC queue: a cell is free for the producer at position
+ * pos when its seq equals pos, and holds data for the consumer when its seq
+ * equals pos + 1. */
+int ring_push(struct bankData *b, const struct request *r) {
+    uint64_t pos = atomic_load_explicit(&b->tail, memory_order_relaxed);
+    for (;;) {
+        struct cell *c = &b->ring[pos & (RING_SIZE - 1)];
+        uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&b->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                c->req = *r;
+                atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;            /* full */
+        } else {
+            pos = atomic_load_explicit(&b->tail, memory_order_relaxed);
+        }
+    }
+}
+
+int ring_pop(struct bankData *b, struct request *r) {
+    uint64_t pos = atomic_load_explicit(&b->head, memory_order_relaxed);
+    for (;;) {
+        struct cell *c = &b->ring[pos & (RING_SIZE - 1)];
+        uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&b->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *r = c->req;
+                atomic_store_explicit(&c->seq, pos + RING_SIZE, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;            /* empty */
+        } else {
+            pos = atomic_load_explicit(&b->head, memory_order_relaxed);
+        }
+    }
+}
+
+/* Spin briefly, then give the CPU away: clients and servers may outnumber
+ * cores, and a pure spin would starve whoever has to make progress. */
+void backoff(int *spins) {
+    if (++*spins < 64) return;
+    sched_yield();
+}
+
+void serve(struct bankData *b) {
+    struct request r;
+    for (;;) {
+        int spins = 0;
+        while (!ring_pop(b, &r)) backoff(&spins);
+        if (r.option == 'q') return;
+
+        int status = ST_OK;
+        int64_t bal;
+        if (r.option == 'a') {
+            if (r.amount > 0) bal = atomic_fetch_add(&b->balance, r.amount) + r.amount;
+            else { status = ST_INVALID; bal = atomic_load(&b->balance); }
+        } else if (r.option == 'w') {
+            bal = atomic_load(&b->balance);
+            if (r.amount <= 0) status = ST_INVALID;
+            else {
+                /* CAS loop: the check and the subtraction happen as one step */
+                while (r.amount <= bal && !atomic_compare_exchange_weak(&b->balance, &bal, bal - r.amount))
+                    ;
+                if (r.amount <= bal) bal -= r.amount;
+                else status = ST_INSUFFICIENT;
+            }
+        } else if (r.option == 'c') {
+            bal = atomic_load(&b->balance);
+        } else {
+            status = ST_INVALID;
+            bal = atomic_load(&b->balance);
+        }
+
+        struct reply *rp = &b->replies[r.client];
+        rp->status = status;
+        rp->balance = bal;
+        atomic_store_explicit(&rp->seq, r.seq, memory_order_release);
+    }
+}
+
+/* Submits one request and waits for its reply; returns the status. */
+int transact(struct bankData *b, int client, uint64_t seq, char option, int64_t amount, int64_t *balance) {
+    struct request r = { option, client, amount, seq };
+    int spins = 0;
+    while (!ring_push(b, &r)) backoff(&spins);
+    struct reply *rp = &b->replies[client];
+    spins = 0;
+    while (atomic_load_explicit(&rp->seq, memory_order_acquire) != seq) backoff(&spins);
+    *balance = rp->balance;
+    return rp->status;
+}
+
+struct bankData *bank_create(int *shmid) {
+    *shmid = shmget(IPC_PRIVATE, sizeof(struct bankData), IPC_CREAT | 0666);
+    if (*shmid == -1) {
+        perror("shmget failed");
+        exit(1);
+    }
+    struct bankData *b = (struct bankData *)shmat(*shmid, NULL, 0);
+    if (b == (void *)-1) {
+        perror("shmat failed");
+        exit(1);
+    }
+    memset(b, 0, sizeof(*b));
+    atomic_store(&b->balance, START_BALANCE);
+    for (uint64_t i = 0; i < RING_SIZE; i++) atomic_store(&b->ring[i].seq, i);
+    return b;
+}
+
+void start_servers(struct bankData *b, int n, pid_t *pids) {
+    fflush(stdout);              /* children must not inherit buffered output */
+    for (int i = 0; i < n; i++) {
+        pids[i] = fork();
+        if (pids[i] == -1) {
+            perror("fork failed");
+            exit(1);
+        }
+        if (pids[i] == 0) {
+            serve(b);
+            shmdt(b);
+            exit(0);
+        }
+    }
+}
+
+void stop_servers(struct bankData *b, int n) {
+    struct request q = { 'q', 0, 0, 0 };
+    for (int i = 0; i < n; i++) {
+        int spins = 0;
+        while (!ring_push(b, &q)) backoff(&spins);
+    }
+    for (int i = 0; i < n; i++) wait(NULL);
+}
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Each client runs a closed loop of random transactions and reports the
+ * net amount it moved through a pipe; the final balance must equal the
+ * start plus the sum of all nets. */
+int bench(int max_clients, int tx_per_client, int servers) {
+    int shmid;
+    struct bankData *b = bank_create(&shmid);
+    pid_t spids[MAX_SERVERS];
+    start_servers(b, servers, spids);
+
+    int net_pipe[2];
+    if (pipe(net_pipe) == -1) {
+        perror("pipe failed");
+        exit(1);
+    }
+
+    printf("servers: %d, transactions per client: %d\n", servers, tx_per_client);
+    printf("%8s %12s %14s %8s\n", "clients", "seconds", "tx/s", "balance");
+    int ok = 1;
+    uint64_t seq_base = 0;
+    for (int n = 1; n <= max_clients; n *= 2) {
+        fflush(stdout);
+        int64_t start = atomic_load(&b->balance);
+        double t0 = now_sec();
+        for (int c = 0; c < n; c++) {
+            pid_t pid = fork();
+            if (pid == -1) {
+                perror("fork failed");
+                exit(1);
+            }
+            if (pid == 0) {
+                close(net_pipe[0]);
+                unsigned int rs = (unsigned int)(getpid() * 2654435761u);
+                int64_t net = 0, bal;
+                for (int t = 0; t < tx_per_client; t++) {
+                    int k = rand_r(&rs) % 3;
+                    char op = k == 0 ? 'a' : k == 1 ? 'w' : 'c';
+                    int64_t amount = 1 + rand_r(&rs) % 100;
+                    int st = transact(b, c, seq_base + (uint64_t)t + 1, op, amount, &bal);
+                    if (st == ST_OK && op == 'a') net += amount;
+                    if (st == ST_OK && op == 'w') net -= amount;
+                }
+                write(net_pipe[1], &net, sizeof(net));
+                shmdt(b);
+                exit(0);
+            }
+        }
+        int64_t total = 0;
+        for (int c = 0; c < n; c++) {
+            int64_t net;
+            if (read(net_pipe[0], &net, sizeof(net)) != sizeof(net)) {
+                perror("read failed");
+                exit(1);
+            }
+            total += net;
+        }
+        for (int c = 0; c < n; c++) wait(NULL);
+        double dt = now_sec() - t0;
+        seq_base += (uint64_t)tx_per_client;
+
+        int64_t end = atomic_load(&b->balance);
+        printf("%8d %12.4f %14.0f %8lld%s\n", n, dt, (double)n * tx_per_client / dt, (long long)end,
+               end == start + total ? "" : "  LOST UPDATES");
+        if (end != start + total) ok = 0;
+    }
+
+    stop_servers(b, servers);
+    close(net_pipe[0]);
+    close(net_pipe[1]);
+    shmdt(b);
+    shmctl(shmid, IPC_RMID, NULL);
+    return ok ? 0 : 1;
+}
+
+int interactive(void) {
+    int shmid;
+    struct bankData *b = bank_create(&shmid);
+    pid_t spid;
+    start_servers(b, 1, &spid);
+
+    char option[100];
+    uint64_t seq = 0;
+    for (;;) {
+        printf("Provide Your Input From Given Options:\n");
+        printf("1. Type a to Add Money\n");
+        printf("2. Type w to Withdraw Money\n");
+        printf("3. Type c to Check Balance\n");
+        printf("4. Type q to Quit\n");
+        if (scanf("%99s", option) != 1 || option[0] == 'q') break;
+        printf("Your selection: %s\n", option);
+
+        int64_t amount = 0, bal;
+        if (option[0] == 'a' || option[0] == 'w') {
+            printf("Enter amount to be %s:\n", option[0] == 'a' ? "added" : "withdrawn");
+            long long v;
+            if (scanf("%lld", &v) != 1) break;
+            amount = v;
+        }
+        int st = transact(b, 0, ++seq, option[0], amount, &bal);
+        if (option[0] == 'a') {
+            if (st == ST_OK) printf("Balance added successfully\nUpdated balance after addition:\n%lld\n", (long long)bal);
+            else printf("Adding failed, Invalid amount\n");
+        } else if (option[0] == 'w') {
+            if (st == ST_OK) printf("Balance withdrawn successfully\nUpdated balance after withdrawal:\n%lld\n", (long long)bal);
+            else printf("Withdrawal failed, Invalid amount\n");
+        } else if (option[0] == 'c') {
+            printf("Your current balance is:\n%lld\n", (long long)bal);
+        } else {
+            printf("Invalid selection\n");
+        }
+    }
+    printf("Thank you for using\n");
+
+    stop_servers(b, 1);
+    shmdt(b);
+    shmctl(shmid, IPC_RMID, NULL);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int max_clients = argc > 2 ? atoi(argv[2]) : 16;
+        int tx = argc > 3 ? atoi(argv[3]) : 100000;
+        int servers = argc > 4 ? atoi(argv[4]) : 1;
+        if (max_clients < 1 || max_clients > MAX_CLIENTS || tx < 1 || servers < 1 || servers > MAX_SERVERS) {
+            fprintf(stderr, "clients 1..%d, transactions > 0, servers 1..%d\n", MAX_CLIENTS, MAX_SERVERS);
+            return 1;
+        }
+        return bench(max_clients, tx, servers);
+    }
+    return interactive();
+}
@@ -0,0 +1,261 @@
+/*
+ * Persistent OTP service: one long-lived message queue and a pool of
+ * pre-forked generator and mail workers, instead of two forks and a fresh
+ * queue per login as in task02.c.
+ *
+ *   gcc -O2 task02_service.c -o task02_service
+ *   ./task02_service                                   interactive logins
+ *   ./task02_service bench [clients] [logins] [gens] [mails]
+ *
+ * Message types route everything through the one queue:
+ *   TYPE_GENERATE  login -> any generator worker
+ *   TYPE_MAIL      generator -> any mail worker
+ *   request id     generator / mail -> the login that asked
+ * Request ids start at ID_BASE, so they never collide with worker types.
+ * A login sends one request, receives the OTP from the generator and the
+ * copy from mail, and verifies that they match.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/msg.h>
+#include <sys/random.h>
+#include <sys/wait.h>
+
+#define TYPE_GENERATE 1
+#define TYPE_MAIL 2
+#define ID_BASE 16
+#define MSGS_PER_LOGIN 3          /* most messages one login has queued at once */
+
+struct my_msg {
+    long type;
+    long req_id;                  /* 0 tells a worker to exit */
+    int otp;                      /* -1: workspace rejected */
+    char from;                    /* 'g' generator, 'm' mail */
+    char txt[12];                 /* workspace name */
+};
+
+#define MSG_SIZE (sizeof(struct my_msg) - sizeof(long))
+
+void send_msg(int msgid, struct my_msg *m) {
+    while (msgsnd(msgid, m, MSG_SIZE, 0) == -1) {
+        if (errno != EINTR) {
+            perror("msgsnd failed");
+            exit(1);
+        }
+    }
+}
+
+void recv_msg(int msgid, struct my_msg *m, long type) {
+    while (msgrcv(msgid, m, MSG_SIZE, type, 0) == -1) {
+        if (errno != EINTR) {
+            perror("msgrcv failed");
+            exit(1);
+        }
+    }
+}
+
+/* ---------- workers ---------- */
+
+/* Six-digit codes from a pool refilled with one getrandom() call. */
+int next_otp(void) {
+    static uint32_t pool[1024];
+    static int left = 0;
+    for (;;) {
+        if (left == 0) {
+            if (getrandom(pool, sizeof(pool), 0) != (ssize_t)sizeof(pool)) {
+                perror("getrandom failed");
+                exit(1);
+            }
+            left = 1024;
+        }
+        uint32_t v = pool[--left];
+        if (v < UINT32_MAX - UINT32_MAX % 900000) return 100000 + (int)(v % 900000);
+    }
+}
+
+void generator_worker(int msgid) {
+    struct my_msg m;
+    for (;;) {
+        recv_msg(msgid, &m, TYPE_GENERATE);
+        if (m.req_id == 0) exit(0);
+        long id = m.req_id;
+        if (strcmp(m.txt, "cse321") != 0) {
+            m.type = id;
+            m.otp = -1;
+            m.from = 'g';
+            send_msg(msgid, &m);
+            continue;
+        }
+        m.otp = next_otp();
+
+        m.type = TYPE_MAIL;       /* copy for the mail worker */
+        m.from = 'g';
+        send_msg(msgid, &m);
+        m.type = id;              /* and straight back to the login */
+        send_msg(msgid, &m);
+    }
+}
+
+void mail_worker(int msgid) {
+    struct my_msg m;
+    for (;;) {
+        recv_msg(msgid, &m, TYPE_MAIL);
+        if (m.req_id == 0) exit(0);
+        m.type = m.req_id;
+        m.from = 'm';
+        send_msg(msgid, &m);
+    }
+}
+
+pid_t spawn(void (*worker)(int), int msgid) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        exit(1);
+    }
+    if (pid == 0) worker(msgid);
+    return pid;
+}
+
+void stop_workers(int msgid, int gens, int mails) {
+    struct my_msg m;
+    memset(&m, 0, sizeof(m));
+    m.type = TYPE_GENERATE;
+    for (int i = 0; i < gens; i++) send_msg(msgid, &m);
+    m.type = TYPE_MAIL;
+    for (int i = 0; i < mails; i++) send_msg(msgid, &m);
+    for (int i = 0; i < gens + mails; i++) wait(NULL);
+}
+
+/* ---------- login ---------- */
+
+/* Returns 1 if verified, 0 if the OTPs differ, -1 if the workspace is rejected. */
+int login(int msgid, long id, const char *workspace, int verbose) {
+    struct my_msg m;
+    memset(&m, 0, sizeof(m));
+    m.type = TYPE_GENERATE;
+    m.req_id = id;
+    strncpy(m.txt, workspace, sizeof(m.txt) - 1);
+    send_msg(msgid, &m);
+
+    int otp_gen = 0, otp_mail = 0;
+    for (int got = 0; got < 2; got++) {
+        recv_msg(msgid, &m, id);
+        if (m.otp == -1) return -1;
+        if (m.from == 'g') otp_gen = m.otp;
+        else otp_mail = m.otp;
+        if (verbose)
+            printf("Log in received OTP from %s: %d\n", m.from == 'g' ? "OTP generator" : "mail", m.otp);
+    }
+    return otp_gen == otp_mail;
+}
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int bench(int msgid, int clients, int logins) {
+    struct msqid_ds ds;
+    if (msgctl(msgid, IPC_STAT, &ds) == -1) {
+        perror("msgctl failed");
+        return 1;
+    }
+    if ((size_t)clients * MSGS_PER_LOGIN * MSG_SIZE > ds.msg_qbytes) {
+        fprintf(stderr, "at most %zu clients fit in a %lu-byte queue\n",
+                ds.msg_qbytes / (MSGS_PER_LOGIN * MSG_SIZE), (unsigned long)ds.msg_qbytes);
+        return 1;
+    }
+
+    size_t n = (size_t)clients * logins;
+    double *lat = mmap(NULL, n * sizeof(double), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int *failed = mmap(NULL, sizeof(int) * (size_t)clients, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (lat == MAP_FAILED || failed == MAP_FAILED) {
+        perror("mmap failed");
+        return 1;
+    }
+
+    fflush(stdout);
+    double t0 = now_sec();
+    for (int c = 0; c < clients; c++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork failed");
+            exit(1);
+        }
+        if (pid == 0) {
+            for (int i = 0; i < logins; i++) {
+                double s = now_sec();
+                if (login(msgid, ID_BASE + (long)c * logins + i, "cse321", 0) != 1) failed[c]++;
+                lat[(size_t)c * logins + i] = now_sec() - s;
+            }
+            exit(0);
+        }
+    }
+    for (int c = 0; c < clients; c++) wait(NULL);
+    double dt = now_sec() - t0;
+
+    int bad = 0;
+    for (int c = 0; c < clients; c++) bad += failed[c];
+    qsort(lat, n, sizeof(double), cmp_double);
+    printf("%7d %10zu %10.3f %12.0f %10.1f %10.1f %8d\n", clients, n, dt, n / dt,
+           lat[n / 2] * 1e6, lat[(size_t)(n * 0.99)] * 1e6, bad);
+    munmap(lat, n * sizeof(double));
+    munmap(failed, sizeof(int) * (size_t)clients);
+    return bad != 0;
+}
+
+int main(int argc, char *argv[]) {
+    int is_bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+    int clients = is_bench && argc > 2 ? atoi(argv[2]) : 32;
+    int logins = is_bench && argc > 3 ? atoi(argv[3]) : 2000;
+    int gens = is_bench && argc > 4 ? atoi(argv[4]) : 2;
+    int mails = is_bench && argc > 5 ? atoi(argv[5]) : 2;
+    if (clients < 1 || logins < 1 || gens < 1 || mails < 1) {
+        fprintf(stderr, "usage: %s [bench [clients] [logins] [gens] [mails]]\n", argv[0]);
+        return 1;
+    }
+
+    int msgid = msgget(IPC_PRIVATE, IPC_CREAT | 0666);
+    if (msgid == -1) {
+        perror("msgget failed");
+        exit(1);
+    }
+    fflush(stdout);
+    for (int i = 0; i < gens; i++) spawn(generator_worker, msgid);
+    for (int i = 0; i < mails; i++) spawn(mail_worker, msgid);
+
+    int rc = 0;
+    if (is_bench) {
+        printf("workers: %d generator, %d mail\n", gens, mails);
+        printf("%7s %10s %10s %12s %10s %10s %8s\n", "clients", "logins", "seconds", "logins/s", "p50 us", "p99 us", "failed");
+        for (int c = 1; c <= clients && rc == 0; c *= 2) rc = bench(msgid, c, logins);
+    } else {
+        char workspace[10];
+        long id = ID_BASE;
+        for (;;) {
+            printf("Please enter the workspace name (q to quit):\n");
+            if (scanf("%9s", workspace) != 1 || strcmp(workspace, "q") == 0) break;
+            int r = login(msgid, id++, workspace, 1);
+            if (r == -1) printf("Invalid workspace name\n");
+            else printf(r ? "OTP Verified\n" : "OTP Incorrect\n");
+        }
+    }
+
+    stop_workers(msgid, gens, mails);
+    msgctl(msgid, IPC_RMID, NULL);
+    return rc;
+}
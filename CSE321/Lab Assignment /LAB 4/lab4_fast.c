@@ -0,0 +1,1342 @@
+/*
+ * ACL and capability checks without string scans.
+ *
+ *   gcc -O2 lab4_fast.c -o lab4_fast -pthread
+ *   ./lab4_fast                                              the lab4.c checks
+ *   ./lab4_fast bench [users] [resources] [entries] [queries]
+ *   ./lab4_fast batch [users] [resources] [checks]           scalar vs AVX2
+ *   ./lab4_fast compile policy.txt policy.img
+ *   ./lab4_fast check policy.img user resource perms         e.g. Alice File1 rw
+ *   ./lab4_fast gen policy.txt users resources entries       random text policy
+ *   ./lab4_fast rcu [readers] [seconds] [users] [resources] [changes]
+ *
+ * User and resource names are interned once into dense IDs (0, 1, 2, ...)
+ * by an open-addressing FNV-1a hash table, and permissions live in a
+ * users x resources matrix of 3-bit cells (READ | WRITE | EXECUTE), one
+ * matrix for the ACLs and one for the capability lists. A check is two
+ * name lookups and one mask test, or only the mask test when the caller
+ * already holds the IDs.
+ *
+ * Cell (u, r) sits at bit 3 * (u * stride + r) of a packed byte array and
+ * is read with one unaligned 32-bit load and a shift. An empty cell means
+ * "no entry": an entry that grants nothing is the same as no entry.
+ *
+ * bench builds a random policy both ways, runs the same random checks
+ * through lab4.c's strcmp scan and through the matrix, and reports
+ * decisions per second and whether the answers agree.
+ *
+ * checkBatch takes arrays of resolved user IDs, resource IDs and required
+ * masks and writes a decision bitmap, eight checks per AVX2 step with a
+ * gather for the cells. batch times it against a checkACL loop and the
+ * scalar batch on a random matrix.
+ *
+ * compile turns a text policy (see compilePolicy; lab4_policy.txt is the
+ * one from lab4.c) into a binary image of the name tables and matrices,
+ * with no fixed limit on users, resources or name length. loadPolicy
+ * mmap()s an image and uses it in place, so start-up does not grow with
+ * the policy.
+ *
+ * PolicyEngine lets checker threads read while the policy changes: each
+ * read section takes the current immutable Snapshot without a lock, the
+ * updater publishes a changed copy with one atomic exchange, and old
+ * snapshots are freed by epoch-based reclamation once no reader can still
+ * hold them. rcu measures read throughput for growing reader counts with
+ * and without an updater publishing new versions back to back.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+#define MAX_NAME_LEN 20
+#define NO_ID 0xFFFFFFFFu
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+typedef enum {
+    READ = 1,
+    WRITE = 2,
+    EXECUTE = 4
+} Permission;
+
+// Name Table
+
+typedef struct {
+    uint32_t count;         // names interned, IDs 0 .. count-1
+    uint32_t capacity;      // room in hashes/offsets
+    uint32_t mask;          // slot count - 1, a power of two
+    uint32_t *slots;        // ID + 1 per slot, 0 when empty
+    uint32_t *hashes;       // FNV-1a hash of each ID's name
+    uint32_t *offsets;      // where each ID's name starts in pool
+    char *pool;             // the names, NUL-terminated, back to back
+    size_t poolUsed, poolSize;
+} NameTable;
+
+// Permission Matrix
+
+typedef struct {
+    uint32_t rows, cols;    // IDs in use on each axis
+    uint32_t rowCap;        // rows allocated
+    uint32_t stride;        // cells allocated per row
+    uint8_t *cells;         // 3 bits per cell, 4 spare bytes at the end
+} PermMatrix;
+
+typedef struct {
+    NameTable users, resources;
+    PermMatrix acl;         // from each resource's ACL entries
+    PermMatrix cap;         // from each user's capability list
+    void *image;            // mapped policy image the arrays point into, or NULL
+    size_t imageSize;
+} Policy;
+
+// Policy Image
+//
+// Everything a loaded Policy points at, laid out so it can be used where
+// it is mapped: a header of section offsets, then the name tables (slots,
+// hashes, offsets, pool) and the matrix cells, each 64-byte aligned.
+
+#define IMAGE_MAGIC 0x504C4341u     // "ACLP"
+#define IMAGE_VERSION 1
+#define IMAGE_ALIGN 64
+#define MAX_LINE_NAME 255           // longest name the compiler accepts
+
+typedef struct {
+    uint32_t count, mask;
+    uint64_t slots, hashes, offsets, pool;      // byte offsets in the image
+    uint64_t poolBytes;
+} ImageNames;
+
+typedef struct {
+    uint32_t rows, cols, stride, pad;
+    uint64_t cells, cellBytes;
+} ImageMatrix;
+
+typedef struct {
+    uint32_t magic, version;
+    uint64_t size;                  // whole image, header included
+    ImageNames users, resources;
+    ImageMatrix acl, cap;
+} ImageHeader;
+
+// Concurrent Policy
+//
+// Checkers read an immutable Snapshot through PolicyEngine.current without
+// locks; the updater copies it, changes the copy and swaps the pointer.
+// A reader announces the global epoch in its slot while it holds a
+// snapshot, and a replaced snapshot is freed once every announced epoch
+// is newer than the one it was retired in.
+
+#define MAX_READERS 64
+
+typedef struct Snapshot {
+    Policy policy;
+    uint64_t version;
+    uint64_t retiredEpoch;
+    struct Snapshot *nextRetired;
+} Snapshot;
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t epoch;    // epoch of the read in progress, 0 if none
+} ReaderSlot;
+
+typedef struct {
+    _Alignas(64) _Atomic(Snapshot *) current;
+    _Alignas(64) _Atomic uint64_t epoch;    // starts at 1
+    _Atomic int readerCount;
+    ReaderSlot readers[MAX_READERS];
+    Snapshot *retired;                      // updater only, newest first
+    long retiredCount, reclaimed;
+} PolicyEngine;
+
+double now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *xmalloc(size_t n){
+    void *p = malloc(n ? n : 1);
+    if (!p) { perror("malloc failed"); exit(1); }
+    return p;
+}
+
+void *xcalloc(size_t n, size_t size){
+    void *p = calloc(n ? n : 1, size);
+    if (!p) { perror("calloc failed"); exit(1); }
+    return p;
+}
+
+// Utility Functions
+
+void printPermissions(int perm){
+    int first = 1;
+    if (perm & READ) {
+        printf("%sRead", first ? "" : "| ");
+        first = 0;
+    }
+    if (perm & WRITE) {
+        printf("%sWrite", first ? "" : "| ");
+        first = 0;
+    }
+    if (perm & EXECUTE) {
+        printf("%sExecute", first ? "" : "| ");
+        first = 0;
+    }
+    if (first) printf("None");
+}
+
+int hasPermission(int userPerm, int requiredPerm){
+    return (userPerm & requiredPerm) == requiredPerm;
+}
+
+// Interning
+
+uint32_t hashName(const char *name){
+    uint32_t h = FNV_OFFSET;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        h ^= *p;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+void initNames(NameTable *t){
+    memset(t, 0, sizeof(*t));
+    t->mask = 15;
+    t->slots = xcalloc(t->mask + 1, sizeof(uint32_t));
+    t->capacity = 8;
+    t->hashes = xmalloc(t->capacity * sizeof(uint32_t));
+    t->offsets = xmalloc(t->capacity * sizeof(uint32_t));
+    t->poolSize = 256;
+    t->pool = xmalloc(t->poolSize);
+}
+
+void freeNames(NameTable *t){
+    free(t->slots);
+    free(t->hashes);
+    free(t->offsets);
+    free(t->pool);
+}
+
+const char *nameOf(const NameTable *t, uint32_t id){
+    return t->pool + t->offsets[id];
+}
+
+// Slot holding name, or the empty slot where it would go.
+uint32_t probeName(const NameTable *t, const char *name, uint32_t h){
+    uint32_t i = h & t->mask;
+    while (t->slots[i] != 0) {
+        uint32_t id = t->slots[i] - 1;
+        if (t->hashes[id] == h && strcmp(t->pool + t->offsets[id], name) == 0) break;
+        i = (i + 1) & t->mask;
+    }
+    return i;
+}
+
+uint32_t findName(const NameTable *t, const char *name){
+    uint32_t slot = t->slots[probeName(t, name, hashName(name))];
+    return slot ? slot - 1 : NO_ID;
+}
+
+uint32_t internName(NameTable *t, const char *name){
+    uint32_t h = hashName(name);
+    uint32_t i = probeName(t, name, h);
+    if (t->slots[i] != 0) return t->slots[i] - 1;
+
+    if (t->count == NO_ID - 1) { fprintf(stderr, "too many names\n"); exit(1); }
+    if ((uint64_t)(t->count + 1) * 2 > (uint64_t)t->mask + 1) {
+        // keep the load factor at or below 1/2
+        free(t->slots);
+        t->mask = t->mask * 2 + 1;
+        t->slots = xcalloc((size_t)t->mask + 1, sizeof(uint32_t));
+        for (uint32_t id = 0; id < t->count; id++) {
+            uint32_t j = t->hashes[id] & t->mask;
+            while (t->slots[j] != 0) j = (j + 1) & t->mask;
+            t->slots[j] = id + 1;
+        }
+        i = probeName(t, name, h);
+    }
+    if (t->count == t->capacity) {
+        t->capacity *= 2;
+        t->hashes = realloc(t->hashes, (size_t)t->capacity * sizeof(uint32_t));
+        t->offsets = realloc(t->offsets, (size_t)t->capacity * sizeof(uint32_t));
+        if (!t->hashes || !t->offsets) { perror("realloc failed"); exit(1); }
+    }
+    size_t len = strlen(name) + 1;
+    if (t->poolUsed + len > UINT32_MAX) { fprintf(stderr, "name pool full\n"); exit(1); }
+    while (t->poolUsed + len > t->poolSize) {
+        t->poolSize *= 2;
+        t->pool = realloc(t->pool, t->poolSize);
+        if (!t->pool) { perror("realloc failed"); exit(1); }
+    }
+    memcpy(t->pool + t->poolUsed, name, len);
+
+    uint32_t id = t->count++;
+    t->hashes[id] = h;
+    t->offsets[id] = (uint32_t)t->poolUsed;
+    t->poolUsed += len;
+    t->slots[i] = id + 1;
+    return id;
+}
+
+// Matrix Cells
+
+size_t matrixBytes(uint64_t cells){
+    return (size_t)((cells * 3 + 7) / 8) + 4;
+}
+
+int getPerm(const PermMatrix *m, uint32_t row, uint32_t col){
+    if (row >= m->rows || col >= m->cols) return 0;
+    uint64_t bit = 3 * ((uint64_t)row * m->stride + col);
+    uint32_t w;
+    memcpy(&w, m->cells + (bit >> 3), sizeof(w));
+    return (w >> (bit & 7)) & 7;
+}
+
+void putCell(uint8_t *cells, uint64_t index, int perm){
+    uint64_t bit = 3 * index;
+    uint32_t w;
+    memcpy(&w, cells + (bit >> 3), sizeof(w));
+    w = (w & ~(7u << (bit & 7))) | ((uint32_t)(perm & 7) << (bit & 7));
+    memcpy(cells + (bit >> 3), &w, sizeof(w));
+}
+
+void initMatrix(PermMatrix *m){
+    memset(m, 0, sizeof(*m));
+    m->rowCap = 4;
+    m->stride = 4;
+    m->cells = xcalloc(matrixBytes(16), 1);
+}
+
+// Grows the matrix to at least rows x cols, doubling either axis as needed.
+void ensureMatrix(PermMatrix *m, uint32_t rows, uint32_t cols){
+    if (rows > m->rowCap || cols > m->stride) {
+        uint32_t rowCap = m->rowCap, stride = m->stride;
+        while (rowCap < rows) rowCap *= 2;
+        while (stride < cols) stride *= 2;
+        size_t oldBytes = matrixBytes((uint64_t)m->rowCap * m->stride);
+        size_t newBytes = matrixBytes((uint64_t)rowCap * stride);
+        if (stride == m->stride) {
+            // rows are appended, the layout of the old ones does not change
+            m->cells = realloc(m->cells, newBytes);
+            if (!m->cells) { perror("realloc failed"); exit(1); }
+            memset(m->cells + oldBytes, 0, newBytes - oldBytes);
+        } else {
+            uint8_t *cells = xcalloc(newBytes, 1);
+            for (uint32_t r = 0; r < m->rows; r++)
+                for (uint32_t c = 0; c < m->cols; c++) {
+                    int perm = getPerm(m, r, c);
+                    if (perm) putCell(cells, (uint64_t)r * stride + c, perm);
+                }
+            free(m->cells);
+            m->cells = cells;
+        }
+        m->rowCap = rowCap;
+        m->stride = stride;
+    }
+    if (rows > m->rows) m->rows = rows;
+    if (cols > m->cols) m->cols = cols;
+}
+
+void setPerm(PermMatrix *m, uint32_t row, uint32_t col, int perm){
+    ensureMatrix(m, row + 1, col + 1);
+    putCell(m->cells, (uint64_t)row * m->stride + col, perm);
+}
+
+// Policy
+
+void initPolicy(Policy *p){
+    memset(p, 0, sizeof(*p));
+    initNames(&p->users);
+    initNames(&p->resources);
+    initMatrix(&p->acl);
+    initMatrix(&p->cap);
+}
+
+void freePolicy(Policy *p){
+    if (p->image) {
+        munmap(p->image, p->imageSize);
+        return;
+    }
+    freeNames(&p->users);
+    freeNames(&p->resources);
+    free(p->acl.cells);
+    free(p->cap.cells);
+}
+
+// Both matrices are indexed [user][resource] and cover every name interned
+// so far; a new entry replaces an old one.
+void addACLEntry(Policy *p, const char *resourceName, const char *userName, int perm){
+    uint32_t r = internName(&p->resources, resourceName);
+    uint32_t u = internName(&p->users, userName);
+    ensureMatrix(&p->acl, p->users.count, p->resources.count);
+    setPerm(&p->acl, u, r, perm);
+}
+
+void addCapability(Policy *p, const char *userName, const char *resourceName, int perm){
+    uint32_t u = internName(&p->users, userName);
+    uint32_t r = internName(&p->resources, resourceName);
+    ensureMatrix(&p->cap, p->users.count, p->resources.count);
+    setPerm(&p->cap, u, r, perm);
+}
+
+int checkACL(const Policy *p, uint32_t user, uint32_t resource, int perm){
+    return hasPermission(getPerm(&p->acl, user, resource), perm);
+}
+
+int checkCapability(const Policy *p, uint32_t user, uint32_t resource, int perm){
+    return hasPermission(getPerm(&p->cap, user, resource), perm);
+}
+
+// Same decision by name; unknown names are denied.
+int checkACLByName(const Policy *p, const char *userName, const char *resourceName, int perm){
+    uint32_t u = findName(&p->users, userName), r = findName(&p->resources, resourceName);
+    return u != NO_ID && r != NO_ID && checkACL(p, u, r, perm);
+}
+
+// Batch Checks
+//
+// Check i is (users[i], resources[i], perms[i]); its decision is bit i % 8
+// of decisions[i / 8], 1 for granted. IDs outside the matrix (NO_ID, say)
+// are denied.
+
+void checkBatchScalar(const PermMatrix *m, const uint32_t *users, const uint32_t *resources,
+                      const uint8_t *perms, size_t n, uint8_t *decisions){
+    memset(decisions, 0, (n + 7) / 8);
+    for (size_t i = 0; i < n; i++) {
+        if (users[i] >= m->rows || resources[i] >= m->cols) continue;
+        if (hasPermission(getPerm(m, users[i], resources[i]), perms[i]))
+            decisions[i / 8] |= (uint8_t)(1u << (i % 8));
+    }
+}
+
+// Eight checks per step: the cell index u * stride + r, its bit offset and
+// the byte holding it are worked out per lane, one gather loads 32 bits
+// from each of those bytes, and a shift and mask leave the 3-bit cells.
+// The lane test is hasPermission's (cell & perm) == perm, and movemask
+// turns the eight results into one byte of the bitmap. Bit offsets are
+// 32-bit, so the matrix must stay below 2^32 / 3 cells.
+__attribute__((target("avx2")))
+void checkBatchAVX2(const PermMatrix *m, const uint32_t *users, const uint32_t *resources,
+                    const uint8_t *perms, size_t n, uint8_t *decisions){
+    const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+    const __m256i rows = _mm256_set1_epi32((int32_t)(m->rows ^ 0x80000000u));
+    const __m256i cols = _mm256_set1_epi32((int32_t)(m->cols ^ 0x80000000u));
+    const __m256i stride = _mm256_set1_epi32((int32_t)m->stride);
+    const __m256i seven = _mm256_set1_epi32(7);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i u = _mm256_loadu_si256((const __m256i *)(users + i));
+        __m256i r = _mm256_loadu_si256((const __m256i *)(resources + i));
+        __m256i req = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(perms + i)));
+        // unsigned u < rows && r < cols, by flipping the sign bits
+        __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(rows, _mm256_xor_si256(u, flip)),
+                                         _mm256_cmpgt_epi32(cols, _mm256_xor_si256(r, flip)));
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(u, stride), r);
+        index = _mm256_and_si256(index, valid);                      // cell 0 for invalid lanes
+        __m256i bit = _mm256_add_epi32(index, _mm256_add_epi32(index, index));
+        __m256i word = _mm256_i32gather_epi32((const int *)m->cells, _mm256_srli_epi32(bit, 3), 1);
+        __m256i cell = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(bit, seven)), seven);
+        __m256i ok = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(cell, req), req), valid);
+        decisions[i / 8] = (uint8_t)_mm256_movemask_ps(_mm256_castsi256_ps(ok));
+    }
+    if (i < n) checkBatchScalar(m, users + i, resources + i, perms + i, n - i, decisions + i / 8);
+}
+
+void checkBatch(const PermMatrix *m, const uint32_t *users, const uint32_t *resources,
+                const uint8_t *perms, size_t n, uint8_t *decisions){
+    if ((uint64_t)m->rowCap * m->stride < 0x55555555u && __builtin_cpu_supports("avx2"))
+        checkBatchAVX2(m, users, resources, perms, n, decisions);
+    else
+        checkBatchScalar(m, users, resources, perms, n, decisions);
+}
+
+void checkACLBatch(const Policy *p, const uint32_t *users, const uint32_t *resources,
+                   const uint8_t *perms, size_t n, uint8_t *decisions){
+    checkBatch(&p->acl, users, resources, perms, n, decisions);
+}
+
+void checkCapabilityBatch(const Policy *p, const uint32_t *users, const uint32_t *resources,
+                          const uint8_t *perms, size_t n, uint8_t *decisions){
+    checkBatch(&p->cap, users, resources, perms, n, decisions);
+}
+
+// Policy Images
+
+uint64_t alignImage(uint64_t off){
+    return (off + IMAGE_ALIGN - 1) & ~(uint64_t)(IMAGE_ALIGN - 1);
+}
+
+void placeNames(ImageNames *n, const NameTable *t, uint64_t *off){
+    n->count = t->count;
+    n->mask = t->mask;
+    n->slots = *off;
+    n->hashes = alignImage(n->slots + ((uint64_t)t->mask + 1) * sizeof(uint32_t));
+    n->offsets = alignImage(n->hashes + (uint64_t)t->count * sizeof(uint32_t));
+    n->pool = alignImage(n->offsets + (uint64_t)t->count * sizeof(uint32_t));
+    n->poolBytes = t->poolUsed;
+    *off = alignImage(n->pool + n->poolBytes);
+}
+
+// Only the rows in use are written; the 4 spare bytes come along.
+void placeMatrix(ImageMatrix *im, const PermMatrix *m, uint64_t *off){
+    im->rows = m->rows;
+    im->cols = m->cols;
+    im->stride = m->stride;
+    im->pad = 0;
+    im->cells = *off;
+    im->cellBytes = matrixBytes((uint64_t)m->rows * m->stride);
+    *off = alignImage(im->cells + im->cellBytes);
+}
+
+void writeAt(int fd, const void *buf, uint64_t len, uint64_t off){
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t w = pwrite(fd, p, len, (off_t)off);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) { perror("write image failed"); exit(1); }
+        p += w;
+        off += (uint64_t)w;
+        len -= (uint64_t)w;
+    }
+}
+
+void writeNames(int fd, const ImageNames *n, const NameTable *t){
+    writeAt(fd, t->slots, ((uint64_t)t->mask + 1) * sizeof(uint32_t), n->slots);
+    writeAt(fd, t->hashes, (uint64_t)t->count * sizeof(uint32_t), n->hashes);
+    writeAt(fd, t->offsets, (uint64_t)t->count * sizeof(uint32_t), n->offsets);
+    writeAt(fd, t->pool, n->poolBytes, n->pool);
+}
+
+// Writes path.tmp and renames it over path, so readers see the old image or the new one.
+uint64_t savePolicy(const Policy *p, const char *path){
+    ImageHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = IMAGE_MAGIC;
+    h.version = IMAGE_VERSION;
+    uint64_t off = alignImage(sizeof(h));
+    placeNames(&h.users, &p->users, &off);
+    placeNames(&h.resources, &p->resources, &off);
+    placeMatrix(&h.acl, &p->acl, &off);
+    placeMatrix(&h.cap, &p->cap, &off);
+    h.size = off;
+
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) { fprintf(stderr, "image path too long\n"); exit(1); }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) { perror("open image failed"); exit(1); }
+    if (ftruncate(fd, (off_t)h.size) == -1) { perror("ftruncate failed"); exit(1); }
+    writeAt(fd, &h, sizeof(h), 0);
+    writeNames(fd, &h.users, &p->users);
+    writeNames(fd, &h.resources, &p->resources);
+    writeAt(fd, p->acl.cells, h.acl.cellBytes, h.acl.cells);
+    writeAt(fd, p->cap.cells, h.cap.cellBytes, h.cap.cells);
+    // the data must be on disk before the rename can expose it under path
+    if (fsync(fd) == -1) { perror("fsync image failed"); exit(1); }
+    if (close(fd) == -1) { perror("close image failed"); exit(1); }
+    if (rename(tmp, path) == -1) { perror("rename image failed"); exit(1); }
+    return h.size;
+}
+
+int sectionFits(uint64_t off, uint64_t len, uint64_t size){
+    return off % sizeof(uint32_t) == 0 && off <= size && len <= size - off;
+}
+
+// One pass over a mapped table: each id sits in exactly one slot and every
+// name starts inside the pool, which ends in '\0'. With count at most half
+// the slots, probeName always reaches an empty slot and nameOf stays in bounds.
+int slotsValid(const ImageNames *n, const char *base){
+    const uint32_t *slots = (const uint32_t *)(base + n->slots);
+    const uint32_t *offsets = (const uint32_t *)(base + n->offsets);
+    uint8_t *seen = xcalloc((size_t)n->count / 8 + 1, 1);
+    uint64_t used = 0;
+    int ok = 1;
+    for (uint64_t i = 0; i <= n->mask; i++) {
+        if (slots[i] == 0) continue;
+        uint32_t id = slots[i] - 1;
+        if (slots[i] > n->count || (seen[id / 8] >> (id % 8) & 1)) { ok = 0; break; }
+        seen[id / 8] |= (uint8_t)(1u << (id % 8));
+        used++;
+    }
+    for (uint32_t id = 0; ok && id < n->count; id++)
+        if (offsets[id] >= n->poolBytes) ok = 0;
+    free(seen);
+    return ok && used == n->count;
+}
+
+int namesFit(const ImageNames *n, const char *base, uint64_t size){
+    uint64_t slots = (uint64_t)n->mask + 1;
+    return (slots & n->mask) == 0 && (uint64_t)n->count * 2 <= slots
+        && sectionFits(n->slots, slots * sizeof(uint32_t), size)
+        && sectionFits(n->hashes, (uint64_t)n->count * sizeof(uint32_t), size)
+        && sectionFits(n->offsets, (uint64_t)n->count * sizeof(uint32_t), size)
+        && sectionFits(n->pool, n->poolBytes, size)
+        && (n->poolBytes == 0 ? n->count == 0 : base[n->pool + n->poolBytes - 1] == '\0')
+        && slotsValid(n, base);
+}
+
+// Rows are user IDs and columns resource IDs, so neither can exceed its name
+// table. The cell count is bounded by cellBytes (itself inside the image)
+// rather than multiplied out, so no size computation can wrap.
+int matrixFits(const ImageMatrix *m, uint32_t users, uint32_t resources, uint64_t size){
+    return m->stride > 0 && m->cols <= m->stride
+        && m->rows <= users && m->cols <= resources
+        && sectionFits(m->cells, m->cellBytes, size) && m->cellBytes >= 4
+        && (uint64_t)m->rows * m->stride <= (m->cellBytes - 4) * 8 / 3;
+}
+
+void mapNames(NameTable *t, const ImageNames *n, char *base){
+    memset(t, 0, sizeof(*t));
+    t->count = t->capacity = n->count;
+    t->mask = n->mask;
+    t->slots = (uint32_t *)(base + n->slots);
+    t->hashes = (uint32_t *)(base + n->hashes);
+    t->offsets = (uint32_t *)(base + n->offsets);
+    t->pool = base + n->pool;
+    t->poolUsed = t->poolSize = n->poolBytes;
+}
+
+void mapMatrix(PermMatrix *m, const ImageMatrix *im, char *base){
+    m->rows = m->rowCap = im->rows;
+    m->cols = im->cols;
+    m->stride = im->stride;
+    m->cells = (uint8_t *)(base + im->cells);
+}
+
+// Maps a compiled image and points p at it: no parsing, no copying, and
+// pages come in as checks touch them. The header and section bounds are
+// checked, and so are the name tables (see slotsValid), so a damaged image
+// cannot send a lookup out of bounds or into an endless probe; any 3-bit
+// cell is a valid permission set. The mapping is read-only, so the policy
+// cannot be changed once loaded.
+void loadPolicy(Policy *p, const char *path){
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) { perror("open image failed"); exit(1); }
+    struct stat st;
+    if (fstat(fd, &st) == -1) { perror("fstat failed"); exit(1); }
+    if ((uint64_t)st.st_size < sizeof(ImageHeader)) { fprintf(stderr, "%s: not a policy image\n", path); exit(1); }
+    char *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap failed"); exit(1); }
+    close(fd);
+
+    const ImageHeader *h = (const ImageHeader *)base;
+    uint64_t size = (uint64_t)st.st_size;
+    if (h->magic != IMAGE_MAGIC || h->version != IMAGE_VERSION || h->size != size
+        || !namesFit(&h->users, base, size) || !namesFit(&h->resources, base, size)
+        || !matrixFits(&h->acl, h->users.count, h->resources.count, size)
+        || !matrixFits(&h->cap, h->users.count, h->resources.count, size)) {
+        fprintf(stderr, "%s: not a policy image, or a damaged one\n", path);
+        exit(1);
+    }
+    memset(p, 0, sizeof(*p));
+    mapNames(&p->users, &h->users, base);
+    mapNames(&p->resources, &h->resources, base);
+    mapMatrix(&p->acl, &h->acl, base);
+    mapMatrix(&p->cap, &h->cap, base);
+    p->image = base;
+    p->imageSize = (size_t)size;
+}
+
+// "r", "rw", "r-x", "rwx", ...; -1 for anything else.
+int parsePerms(const char *s){
+    int perm = 0;
+    for (; *s; s++) {
+        if (*s == 'r') perm |= READ;
+        else if (*s == 'w') perm |= WRITE;
+        else if (*s == 'x') perm |= EXECUTE;
+        else if (*s != '-') return -1;
+    }
+    return perm;
+}
+
+// Text policy, one statement per line, '#' starts a comment:
+//
+//   user NAME
+//   resource NAME
+//   acl RESOURCE USER PERMS       an entry in RESOURCE's ACL
+//   cap USER RESOURCE PERMS       a capability in USER's list
+int compilePolicy(const char *textPath, const char *imagePath){
+    double t0 = now_sec();
+    int fd = open(textPath, O_RDONLY);
+    if (fd == -1) { perror("open policy failed"); exit(1); }
+    struct stat st;
+    if (fstat(fd, &st) == -1) { perror("fstat failed"); exit(1); }
+    const char *text = "";
+    if (st.st_size > 0) {
+        text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) { perror("mmap failed"); exit(1); }
+        posix_madvise((void *)text, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    Policy p;
+    initPolicy(&p);
+    long line = 0, aclEntries = 0, capabilities = 0;
+    const char *q = text, *end = text + st.st_size;
+    while (q < end) {
+        const char *eol = memchr(q, '\n', (size_t)(end - q));
+        if (!eol) eol = end;
+        line++;
+        char tok[4][MAX_LINE_NAME + 1];
+        int n = 0, tooLong = 0;
+        const char *c = q;
+        for (;;) {
+            while (c < eol && (*c == ' ' || *c == '\t' || *c == '\r')) c++;
+            if (c == eol || *c == '#') break;
+            const char *w = c;
+            while (c < eol && *c != ' ' && *c != '\t' && *c != '\r') c++;
+            if (n == 4 || c - w > MAX_LINE_NAME) { tooLong = 1; break; }
+            memcpy(tok[n], w, (size_t)(c - w));
+            tok[n][c - w] = '\0';
+            n++;
+        }
+        q = eol < end ? eol + 1 : end;
+        if (n == 0 && !tooLong) continue;
+
+        int perm = n == 4 ? parsePerms(tok[3]) : -1;
+        if (!tooLong && n == 2 && strcmp(tok[0], "user") == 0) {
+            internName(&p.users, tok[1]);
+        } else if (!tooLong && n == 2 && strcmp(tok[0], "resource") == 0) {
+            internName(&p.resources, tok[1]);
+        } else if (!tooLong && perm >= 0 && strcmp(tok[0], "acl") == 0) {
+            addACLEntry(&p, tok[1], tok[2], perm);
+            aclEntries++;
+        } else if (!tooLong && perm >= 0 && strcmp(tok[0], "cap") == 0) {
+            addCapability(&p, tok[1], tok[2], perm);
+            capabilities++;
+        } else {
+            fprintf(stderr, "%s:%ld: expected 'user NAME', 'resource NAME', 'acl RESOURCE USER PERMS' "
+                            "or 'cap USER RESOURCE PERMS' (names up to %d bytes)\n", textPath, line, MAX_LINE_NAME);
+            exit(1);
+        }
+    }
+    if (st.st_size > 0) munmap((void *)text, (size_t)st.st_size);
+
+    // names declared after the last entry still get rows and columns
+    ensureMatrix(&p.acl, p.users.count, p.resources.count);
+    ensureMatrix(&p.cap, p.users.count, p.resources.count);
+    uint64_t size = savePolicy(&p, imagePath);
+    printf("%u users, %u resources, %ld ACL entries, %ld capabilities -> %s (%llu bytes) in %.3f s\n",
+           p.users.count, p.resources.count, aclEntries, capabilities, imagePath,
+           (unsigned long long)size, now_sec() - t0);
+    freePolicy(&p);
+    return 0;
+}
+
+// Concurrent Policy
+
+// Deep copy into malloc()ed memory, from a built or a loaded policy.
+void clonePolicy(Policy *dst, const Policy *src){
+    memset(dst, 0, sizeof(*dst));
+    const NameTable *names[2] = {&src->users, &src->resources};
+    NameTable *copies[2] = {&dst->users, &dst->resources};
+    for (int i = 0; i < 2; i++) {
+        const NameTable *t = names[i];
+        NameTable *c = copies[i];
+        *c = *t;
+        c->capacity = t->count ? t->count : 1;
+        c->poolSize = t->poolUsed ? t->poolUsed : 1;
+        c->slots = xmalloc(((size_t)t->mask + 1) * sizeof(uint32_t));
+        c->hashes = xmalloc((size_t)c->capacity * sizeof(uint32_t));
+        c->offsets = xmalloc((size_t)c->capacity * sizeof(uint32_t));
+        c->pool = xmalloc(c->poolSize);
+        memcpy(c->slots, t->slots, ((size_t)t->mask + 1) * sizeof(uint32_t));
+        memcpy(c->hashes, t->hashes, (size_t)t->count * sizeof(uint32_t));
+        memcpy(c->offsets, t->offsets, (size_t)t->count * sizeof(uint32_t));
+        memcpy(c->pool, t->pool, t->poolUsed);
+    }
+    const PermMatrix *matrices[2] = {&src->acl, &src->cap};
+    PermMatrix *mcopies[2] = {&dst->acl, &dst->cap};
+    for (int i = 0; i < 2; i++) {
+        const PermMatrix *m = matrices[i];
+        PermMatrix *c = mcopies[i];
+        *c = *m;
+        c->rowCap = m->rows ? m->rows : 1;
+        c->cells = xcalloc(matrixBytes((uint64_t)c->rowCap * m->stride), 1);
+        memcpy(c->cells, m->cells, matrixBytes((uint64_t)m->rows * m->stride));
+    }
+}
+
+void initEngine(PolicyEngine *e, Snapshot *first){
+    memset(e, 0, sizeof(*e));
+    atomic_store(&e->current, first);
+    atomic_store(&e->epoch, 1);
+}
+
+// Returns the reader's slot, one per checker thread.
+int registerReader(PolicyEngine *e){
+    int slot = atomic_fetch_add(&e->readerCount, 1);
+    if (slot >= MAX_READERS) { fprintf(stderr, "more than %d readers\n", MAX_READERS); exit(1); }
+    return slot;
+}
+
+// The snapshot stays valid until endRead. The epoch is announced before
+// current is loaded (both seq_cst), so an updater that misses the
+// announcement has already swapped and this reader gets the new snapshot.
+const Snapshot *beginRead(PolicyEngine *e, int slot){
+    atomic_store(&e->readers[slot].epoch, atomic_load(&e->epoch));
+    return atomic_load(&e->current);
+}
+
+void endRead(PolicyEngine *e, int slot){
+    atomic_store_explicit(&e->readers[slot].epoch, 0, memory_order_release);
+}
+
+void freeSnapshot(Snapshot *s){
+    freePolicy(&s->policy);
+    free(s);
+}
+
+// Frees the retired snapshots no reader can still hold.
+void reclaimSnapshots(PolicyEngine *e){
+    uint64_t oldest = UINT64_MAX;
+    int readers = atomic_load(&e->readerCount);
+    for (int i = 0; i < readers && i < MAX_READERS; i++) {
+        uint64_t seen = atomic_load(&e->readers[i].epoch);
+        if (seen != 0 && seen < oldest) oldest = seen;
+    }
+    Snapshot **link = &e->retired;
+    while (*link) {
+        Snapshot *s = *link;
+        if (s->retiredEpoch < oldest) {
+            *link = s->nextRetired;
+            freeSnapshot(s);
+            e->retiredCount--;
+            e->reclaimed++;
+        } else {
+            link = &s->nextRetired;
+        }
+    }
+}
+
+// Single updater: swaps next in, retires the old snapshot at the epoch
+// before the bump and frees whatever has become unreachable.
+void publishPolicy(PolicyEngine *e, Snapshot *next){
+    Snapshot *old = atomic_exchange(&e->current, next);
+    old->retiredEpoch = atomic_fetch_add(&e->epoch, 1);
+    old->nextRetired = e->retired;
+    e->retired = old;
+    e->retiredCount++;
+    reclaimSnapshots(e);
+}
+
+// After all readers have stopped.
+void freeEngine(PolicyEngine *e){
+    while (e->retired) {
+        Snapshot *s = e->retired;
+        e->retired = s->nextRetired;
+        freeSnapshot(s);
+    }
+    freeSnapshot(atomic_load(&e->current));
+}
+
+// ACL System
+
+void checkACLAccess(const Policy *p, const char *userName, const char *resourceName, int perm){
+    uint32_t r = findName(&p->resources, resourceName);
+    uint32_t u = findName(&p->users, userName);
+
+    printf("ACL Check: User %s requests ", userName);
+    printPermissions(perm);
+    printf(" on %s: ", resourceName);
+
+    if (r == NO_ID){
+        printf("Resource NOT found -> Access DENIED\n");
+        return;
+    }
+    int userPerm = u == NO_ID ? 0 : getPerm(&p->acl, u, r);
+    if (!userPerm){
+        printf("User has NO entry for resource -> Access DENIED\n");
+        return;
+    }
+    printf("Access %s (user has ", hasPermission(userPerm, perm) ? "GRANTED" : "DENIED");
+    printPermissions(userPerm);
+    printf(")\n");
+}
+
+// Capability System
+
+void checkCapabilityAccess(const Policy *p, const char *userName, const char *resourceName, int perm){
+    uint32_t u = findName(&p->users, userName);
+    uint32_t r = findName(&p->resources, resourceName);
+
+    printf("Capability Check: User %s requests ", userName);
+    printPermissions(perm);
+    printf(" on %s: ", resourceName);
+
+    if (u == NO_ID){
+        printf("User NOT found -> Access DENIED\n");
+        return;
+    }
+    int capPerm = r == NO_ID ? 0 : getPerm(&p->cap, u, r);
+    if (!capPerm){
+        printf("User has NO capability for resource -> Access DENIED\n");
+        return;
+    }
+    printf("Access %s (user has ", hasPermission(capPerm, perm) ? "GRANTED" : "DENIED");
+    printPermissions(capPerm);
+    printf(")\n");
+}
+
+// Benchmark
+
+// lab4.c's layout, with the entry array sized at run time
+typedef struct {
+    char username[MAX_NAME_LEN];
+    int permissions;
+} ACLEntry;
+
+typedef struct {
+    char name[MAX_NAME_LEN];
+    ACLEntry *entries;
+    int entryCount;
+} ScanResource;
+
+// checkACLAccess from lab4.c without the printing
+int scanACL(const ScanResource *resList, int resCount, const char *userName, const char *resourceName, int perm){
+    const ScanResource *res = NULL;
+    for (int i = 0; i < resCount; i++){
+        if (strcmp(resList[i].name, resourceName) == 0){
+            res = &resList[i];
+            break;
+        }
+    }
+    if (!res) return 0;
+    for (int i = 0; i < res->entryCount; i++){
+        if (strcmp(res->entries[i].username, userName) == 0)
+            return hasPermission(res->entries[i].permissions, perm);
+    }
+    return 0;
+}
+
+uint64_t nextRandom(uint64_t *x){
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+int bench(int users, int resources, int entries, int queries){
+    if (users < 1 || resources < 1 || entries < 0 || entries > users || queries < 1) {
+        fprintf(stderr, "bench needs users >= 1, resources >= 1, 0 <= entries <= users, queries >= 1\n");
+        return 1;
+    }
+    char (*userNames)[MAX_NAME_LEN] = xmalloc((size_t)users * MAX_NAME_LEN);
+    char (*resNames)[MAX_NAME_LEN] = xmalloc((size_t)(resources + 1) * MAX_NAME_LEN);
+    for (int i = 0; i < users; i++) snprintf(userNames[i], MAX_NAME_LEN, "user%d", i);
+    for (int i = 0; i <= resources; i++) snprintf(resNames[i], MAX_NAME_LEN, "file%d", i);   // last one is never granted
+
+    // the same random ACLs both ways; entries per resource go to distinct users
+    uint64_t x = 88172645463325252ull;
+    Policy p;
+    initPolicy(&p);
+    ScanResource *scan = xmalloc((size_t)resources * sizeof(ScanResource));
+    char *taken = xcalloc((size_t)users, 1);
+    int *chosen = xmalloc((size_t)(entries ? entries : 1) * sizeof(int));
+    double t0 = now_sec();
+    for (int i = 0; i < users; i++) internName(&p.users, userNames[i]);
+    for (int i = 0; i < resources; i++) internName(&p.resources, resNames[i]);
+    ensureMatrix(&p.acl, (uint32_t)users, (uint32_t)resources);
+    for (int r = 0; r < resources; r++) {
+        strcpy(scan[r].name, resNames[r]);
+        scan[r].entries = xmalloc((size_t)entries * sizeof(ACLEntry));
+        scan[r].entryCount = entries;
+        for (int e = 0; e < entries; e++) {
+            int u;
+            do u = (int)(nextRandom(&x) % (uint64_t)users); while (taken[u]);
+            taken[u] = 1;
+            chosen[e] = u;
+            int perm = 1 + (int)(nextRandom(&x) % 7);
+            strcpy(scan[r].entries[e].username, userNames[u]);
+            scan[r].entries[e].permissions = perm;
+            addACLEntry(&p, resNames[r], userNames[u], perm);
+        }
+        for (int e = 0; e < entries; e++) taken[chosen[e]] = 0;
+    }
+    double tBuild = now_sec() - t0;
+
+    // random checks, a few against a missing resource
+    const char **qUser = xmalloc((size_t)queries * sizeof(char *));
+    const char **qRes = xmalloc((size_t)queries * sizeof(char *));
+    uint32_t *qUid = xmalloc((size_t)queries * sizeof(uint32_t));
+    uint32_t *qRid = xmalloc((size_t)queries * sizeof(uint32_t));
+    int *qPerm = xmalloc((size_t)queries * sizeof(int));
+    for (int i = 0; i < queries; i++) {
+        qUser[i] = userNames[nextRandom(&x) % (uint64_t)users];
+        qRes[i] = resNames[nextRandom(&x) % (uint64_t)(resources + 1)];
+        qPerm[i] = 1 + (int)(nextRandom(&x) % 7);
+        qUid[i] = findName(&p.users, qUser[i]);
+        qRid[i] = findName(&p.resources, qRes[i]);
+    }
+    char *slow = xmalloc((size_t)queries), *byName = xmalloc((size_t)queries), *byId = xmalloc((size_t)queries);
+
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) slow[i] = (char)scanACL(scan, resources, qUser[i], qRes[i], qPerm[i]);
+    double tScan = now_sec() - t0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) byName[i] = (char)checkACLByName(&p, qUser[i], qRes[i], qPerm[i]);
+    double tName = now_sec() - t0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) byId[i] = (char)checkACL(&p, qUid[i], qRid[i], qPerm[i]);
+    double tId = now_sec() - t0;
+
+    long granted = 0;
+    for (int i = 0; i < queries; i++) granted += slow[i];
+    int same = memcmp(slow, byName, (size_t)queries) == 0 && memcmp(slow, byId, (size_t)queries) == 0;
+    printf("%d users, %d resources, %d ACL entries each, %d checks (%ld granted)\n",
+           users, resources, entries, queries, granted);
+    printf("matrix: %u x %u cells, %zu bytes, built in %.3f s\n",
+           p.acl.rows, p.acl.cols, matrixBytes((uint64_t)p.acl.rowCap * p.acl.stride), tBuild);
+    printf("%-14s %16s\n", "path", "decisions/s");
+    printf("%-14s %16.0f\n", "strcmp scan", queries / tScan);
+    printf("%-14s %16.0f\n", "interned names", queries / tName);
+    printf("%-14s %16.0f\n", "resolved IDs", queries / tId);
+    printf("decisions %s\n", same ? "match" : "DIFFER");
+
+    for (int r = 0; r < resources; r++) free(scan[r].entries);
+    free(scan);
+    free(taken);
+    free(chosen);
+    free(userNames);
+    free(resNames);
+    free(qUser);
+    free(qRes);
+    free(qUid);
+    free(qRid);
+    free(qPerm);
+    free(slow);
+    free(byName);
+    free(byId);
+    freePolicy(&p);
+    return same ? 0 : 1;
+}
+
+int benchBatch(int users, int resources, int checks){
+    if (users < 1 || resources < 1 || checks < 1) {
+        fprintf(stderr, "batch needs users, resources and checks >= 1\n");
+        return 1;
+    }
+    // every cell random, about 1 check in 64 with an unknown user
+    uint64_t x = 88172645463325252ull;
+    Policy p;
+    initPolicy(&p);
+    ensureMatrix(&p.acl, (uint32_t)users, (uint32_t)resources);
+    for (int u = 0; u < users; u++)
+        for (int r = 0; r < resources; r++) setPerm(&p.acl, (uint32_t)u, (uint32_t)r, (int)(nextRandom(&x) % 8));
+
+    uint32_t *qUid = xmalloc((size_t)checks * sizeof(uint32_t));
+    uint32_t *qRid = xmalloc((size_t)checks * sizeof(uint32_t));
+    uint8_t *qPerm = xmalloc((size_t)checks);
+    for (int i = 0; i < checks; i++) {
+        uint64_t v = nextRandom(&x);
+        qUid[i] = (v >> 58) == 0 ? NO_ID : (uint32_t)(v % (uint64_t)users);
+        qRid[i] = (uint32_t)(nextRandom(&x) % (uint64_t)resources);
+        qPerm[i] = (uint8_t)(1 + nextRandom(&x) % 7);
+    }
+    size_t bytes = ((size_t)checks + 7) / 8;
+    uint8_t *single = xcalloc(bytes, 1), *scalar = xmalloc(bytes), *simd = xmalloc(bytes);
+
+    int rounds = 10;
+    double t0 = now_sec();
+    for (int k = 0; k < rounds; k++)
+        for (int i = 0; i < checks; i++)
+            if (checkACL(&p, qUid[i], qRid[i], qPerm[i])) single[i / 8] |= (uint8_t)(1u << (i % 8));
+    double tSingle = now_sec() - t0;
+    t0 = now_sec();
+    for (int k = 0; k < rounds; k++) checkBatchScalar(&p.acl, qUid, qRid, qPerm, (size_t)checks, scalar);
+    double tScalar = now_sec() - t0;
+    int simdOk = __builtin_cpu_supports("avx2");
+    double tSimd = 0;
+    if (simdOk) {
+        t0 = now_sec();
+        for (int k = 0; k < rounds; k++) checkACLBatch(&p, qUid, qRid, qPerm, (size_t)checks, simd);
+        tSimd = now_sec() - t0;
+    }
+
+    long granted = 0;
+    for (size_t i = 0; i < bytes; i++) granted += __builtin_popcount(scalar[i]);
+    int same = memcmp(single, scalar, bytes) == 0 && (!simdOk || memcmp(scalar, simd, bytes) == 0);
+    double total = (double)checks * rounds;
+    printf("%d x %d matrix (%zu bytes), %d checks x %d rounds (%ld granted)\n", users, resources,
+           matrixBytes((uint64_t)p.acl.rowCap * p.acl.stride), checks, rounds, granted);
+    printf("%-14s %16s\n", "path", "decisions/s");
+    printf("%-14s %16.0f\n", "checkACL loop", total / tSingle);
+    printf("%-14s %16.0f\n", "batch scalar", total / tScalar);
+    if (simdOk) printf("%-14s %16.0f\n", "batch avx2", total / tSimd);
+    else printf("%-14s %16s\n", "batch avx2", "(no AVX2)");
+    printf("decisions %s\n", same ? "match" : "DIFFER");
+
+    free(qUid);
+    free(qRid);
+    free(qPerm);
+    free(single);
+    free(scalar);
+    free(simd);
+    freePolicy(&p);
+    return same ? 0 : 1;
+}
+
+// Random text policy in compilePolicy's format, each grant as both an ACL entry and a capability.
+int genPolicy(const char *path, int users, int resources, int entries){
+    if (users < 1 || resources < 1 || entries < 0 || entries > users) {
+        fprintf(stderr, "gen needs users >= 1, resources >= 1, 0 <= entries <= users\n");
+        return 1;
+    }
+    FILE *out = fopen(path, "w");
+    if (!out) { perror("fopen failed"); exit(1); }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+    for (int i = 0; i < users; i++) fprintf(out, "user user%d\n", i);
+    for (int i = 0; i < resources; i++) fprintf(out, "resource file%d\n", i);
+    const char *perms[] = {"", "r", "w", "rw", "x", "rx", "wx", "rwx"};
+    char *taken = xcalloc((size_t)users, 1);
+    int *chosen = xmalloc((size_t)(entries ? entries : 1) * sizeof(int));
+    uint64_t x = 88172645463325252ull;
+    for (int r = 0; r < resources; r++) {
+        for (int e = 0; e < entries; e++) {
+            int u;
+            do u = (int)(nextRandom(&x) % (uint64_t)users); while (taken[u]);
+            taken[u] = 1;
+            chosen[e] = u;
+            const char *perm = perms[1 + nextRandom(&x) % 7];
+            fprintf(out, "acl file%d user%d %s\ncap user%d file%d %s\n", r, u, perm, u, r, perm);
+        }
+        for (int e = 0; e < entries; e++) taken[chosen[e]] = 0;
+    }
+    if (fclose(out) != 0) { perror("write policy failed"); exit(1); }
+    free(taken);
+    free(chosen);
+    return 0;
+}
+
+int checkImage(const char *imagePath, const char *userName, const char *resourceName, const char *perms){
+    int perm = parsePerms(perms);
+    if (perm <= 0) { fprintf(stderr, "permissions look like r, rw or rwx\n"); return 1; }
+    double t0 = now_sec();
+    Policy p;
+    loadPolicy(&p, imagePath);
+    double tLoad = now_sec() - t0;
+    checkACLAccess(&p, userName, resourceName, perm);
+    checkCapabilityAccess(&p, userName, resourceName, perm);
+    fprintf(stderr, "%s: %u users, %u resources, loaded in %.3f ms, checked in %.3f ms\n", imagePath,
+            p.users.count, p.resources.count, tLoad * 1e3, (now_sec() - t0 - tLoad) * 1e3);
+    freePolicy(&p);
+    return 0;
+}
+
+#define READ_SECTION 256    // checks per beginRead/endRead
+
+typedef struct {
+    PolicyEngine *engine;
+    _Atomic int *stop;
+    uint64_t seed;
+    long decisions, granted, torn;
+} CheckerArgs;
+
+typedef struct {
+    PolicyEngine *engine;
+    _Atomic int *stop;
+    int changes;            // cells rewritten per version
+    long versions;
+} UpdaterArgs;
+
+// Cell (0, 0) of every version holds version % 7 + 1, so a reader that
+// saw a half-built or freed snapshot would notice.
+void *checker(void *arg){
+    CheckerArgs *a = arg;
+    int slot = registerReader(a->engine);
+    uint64_t x = a->seed;
+    long decisions = 0, granted = 0, torn = 0;     // locals, not a->: the CheckerArgs share cache lines
+    while (!atomic_load_explicit(a->stop, memory_order_relaxed)) {
+        const Snapshot *s = beginRead(a->engine, slot);
+        const Policy *p = &s->policy;
+        if (getPerm(&p->acl, 0, 0) != (int)(s->version % 7 + 1)) torn++;
+        for (int k = 0; k < READ_SECTION; k++) {
+            uint64_t v = nextRandom(&x);
+            uint32_t u = (uint32_t)((v & 0xFFFFFFFFu) % p->users.count);
+            uint32_t r = (uint32_t)((v >> 32) % p->resources.count);
+            granted += checkACL(p, u, r, 1 + (int)(v >> 61) % 7);
+        }
+        endRead(a->engine, slot);
+        decisions += READ_SECTION;
+    }
+    a->decisions = decisions;
+    a->granted = granted;
+    a->torn = torn;
+    return NULL;
+}
+
+void *updater(void *arg){
+    UpdaterArgs *a = arg;
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    while (!atomic_load_explicit(a->stop, memory_order_relaxed)) {
+        const Snapshot *cur = atomic_load(&a->engine->current);   // only this thread swaps it
+        Snapshot *next = xmalloc(sizeof(Snapshot));
+        clonePolicy(&next->policy, &cur->policy);
+        next->version = cur->version + 1;
+        PermMatrix *m = &next->policy.acl;
+        for (int k = 0; k < a->changes; k++)
+            setPerm(m, (uint32_t)(nextRandom(&x) % m->rows), (uint32_t)(nextRandom(&x) % m->cols),
+                    (int)(nextRandom(&x) % 8));
+        setPerm(m, 0, 0, (int)(next->version % 7 + 1));
+        publishPolicy(a->engine, next);
+        a->versions++;
+    }
+    return NULL;
+}
+
+// Readers on their own and with an updater publishing back to back, for
+// 1, 2, 4, ... checker threads.
+int benchRCU(int maxReaders, double seconds, int users, int resources, int changes){
+    if (maxReaders < 1 || maxReaders > MAX_READERS - 1 || seconds <= 0 || users < 1 || resources < 1 || changes < 0) {
+        fprintf(stderr, "rcu needs 1..%d readers, seconds > 0, users and resources >= 1, changes >= 0\n", MAX_READERS - 1);
+        return 1;
+    }
+    Snapshot *first = xmalloc(sizeof(Snapshot));
+    initPolicy(&first->policy);
+    char name[32];
+    for (int i = 0; i < users; i++) { snprintf(name, sizeof(name), "user%d", i); internName(&first->policy.users, name); }
+    for (int i = 0; i < resources; i++) { snprintf(name, sizeof(name), "file%d", i); internName(&first->policy.resources, name); }
+    ensureMatrix(&first->policy.acl, (uint32_t)users, (uint32_t)resources);
+    ensureMatrix(&first->policy.cap, (uint32_t)users, (uint32_t)resources);
+    uint64_t x = 88172645463325252ull;
+    for (int u = 0; u < users; u++)
+        for (int r = 0; r < resources; r++) setPerm(&first->policy.acl, (uint32_t)u, (uint32_t)r, (int)(nextRandom(&x) % 8));
+    first->version = 0;
+    setPerm(&first->policy.acl, 0, 0, 1);
+
+    printf("%d x %d policy, %d cells changed per version, %.1f s per run, %ld CPUs\n",
+           users, resources, changes, seconds, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s %-8s %16s %16s %10s %10s %8s\n", "readers", "updates", "decisions/s", "per reader", "versions", "reclaimed", "torn");
+    long tornTotal = 0;
+    for (int readers = 1; ; readers *= 2) {
+        if (readers > maxReaders) readers = maxReaders;
+        for (int updating = 0; updating <= 1; updating++) {
+            PolicyEngine *e = aligned_alloc(64, (sizeof(PolicyEngine) + 63) & ~(size_t)63);
+            if (!e) { perror("aligned_alloc failed"); exit(1); }
+            Snapshot *start = xmalloc(sizeof(Snapshot));
+            clonePolicy(&start->policy, &first->policy);
+            start->version = 0;
+            initEngine(e, start);
+
+            _Atomic int stop = 0;
+            CheckerArgs *ca = xcalloc((size_t)readers, sizeof(CheckerArgs));
+            pthread_t *th = xmalloc((size_t)readers * sizeof(pthread_t));
+            UpdaterArgs ua = { e, &stop, changes, 0 };
+            pthread_t up;
+            double t0 = now_sec();
+            for (int i = 0; i < readers; i++) {
+                ca[i] = (CheckerArgs){ e, &stop, 88172645463325252ull + 7919u * (uint64_t)(i + 1), 0, 0, 0 };
+                if (pthread_create(&th[i], NULL, checker, &ca[i]) != 0) { perror("pthread_create failed"); exit(1); }
+            }
+            if (updating && pthread_create(&up, NULL, updater, &ua) != 0) { perror("pthread_create failed"); exit(1); }
+            struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+            nanosleep(&ts, NULL);
+            atomic_store(&stop, 1);
+            long decisions = 0, torn = 0;
+            for (int i = 0; i < readers; i++) {
+                pthread_join(th[i], NULL);
+                decisions += ca[i].decisions;
+                torn += ca[i].torn;
+            }
+            if (updating) pthread_join(up, NULL);
+            double elapsed = now_sec() - t0;
+            printf("%-8d %-8s %16.0f %16.0f %10ld %10ld %8ld\n", readers, updating ? "yes" : "no",
+                   decisions / elapsed, decisions / elapsed / readers, ua.versions, e->reclaimed, torn);
+            tornTotal += torn;
+            freeEngine(e);
+            free(e);
+            free(ca);
+            free(th);
+        }
+        if (readers == maxReaders) break;
+    }
+    freeSnapshot(first);
+    printf("snapshots %s\n", tornTotal ? "TORN" : "consistent");
+    return tornTotal ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+        return bench(argc > 2 ? atoi(argv[2]) : 1000, argc > 3 ? atoi(argv[3]) : 1000,
+                     argc > 4 ? atoi(argv[4]) : 16, argc > 5 ? atoi(argv[5]) : 1000000);
+    if (argc > 1 && strcmp(argv[1], "batch") == 0)
+        return benchBatch(argc > 2 ? atoi(argv[2]) : 2000, argc > 3 ? atoi(argv[3]) : 2000,
+                          argc > 4 ? atoi(argv[4]) : 1000000);
+    if (argc == 4 && strcmp(argv[1], "compile") == 0)
+        return compilePolicy(argv[2], argv[3]);
+    if (argc == 6 && strcmp(argv[1], "check") == 0)
+        return checkImage(argv[2], argv[3], argv[4], argv[5]);
+    if (argc == 6 && strcmp(argv[1], "gen") == 0)
+        return genPolicy(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+    if (argc > 1 && strcmp(argv[1], "rcu") == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return benchRCU(argc > 2 ? atoi(argv[2]) : (int)(cpus > 1 ? cpus : 2), argc > 3 ? atof(argv[3]) : 1.0,
+                        argc > 4 ? atoi(argv[4]) : 2000, argc > 5 ? atoi(argv[5]) : 2000,
+                        argc > 6 ? atoi(argv[6]) : 1000);
+    }
+    if (argc > 1) {
+        fprintf(stderr, "usage: %s [bench [users] [resources] [entries] [queries]]\n"
+                        "       %s batch [users] [resources] [checks]\n"
+                        "       %s compile policy.txt policy.img\n"
+                        "       %s check policy.img user resource perms\n"
+                        "       %s gen policy.txt users resources entries\n"
+                        "       %s rcu [readers] [seconds] [users] [resources] [changes]\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    // the policy from lab4.c
+    Policy p;
+    initPolicy(&p);
+
+    const char *users[] = {"Alice", "Bob", "Charlie"};
+    const char *resources[] = {"File1", "File2", "File3"};
+    for (int i = 0; i < 3; i++) internName(&p.users, users[i]);
+    for (int i = 0; i < 3; i++) internName(&p.resources, resources[i]);
+
+    addACLEntry(&p, "File1", "Alice", READ | WRITE);
+    addACLEntry(&p, "File1", "Bob", READ);
+    addACLEntry(&p, "File2", "Alice", READ);
+    addACLEntry(&p, "File2", "Charlie", READ | EXECUTE);
+    addACLEntry(&p, "File3", "Bob", WRITE);
+    addACLEntry(&p, "File3", "Charlie", READ | WRITE | EXECUTE);
+
+    addCapability(&p, "Alice", "File1", READ | WRITE);
+    addCapability(&p, "Alice", "File2", READ);
+    addCapability(&p, "Bob", "File1", READ);
+    addCapability(&p, "Bob", "File3", WRITE);
+    addCapability(&p, "Charlie", "File2", READ | EXECUTE);
+    addCapability(&p, "Charlie", "File3", READ | WRITE | EXECUTE);
+
+    // Test ACL
+
+    checkACLAccess(&p, "Alice", "File1", READ);     //  GRANTED
+    checkACLAccess(&p, "Bob", "File1", WRITE);      //  DENIED
+    checkACLAccess(&p, "Charlie", "File1", READ);   //  DENIED
+
+    // Test Capability
+
+    checkCapabilityAccess(&p, "Alice", "File1", WRITE);     //  GRANTED
+    checkCapabilityAccess(&p, "Bob", "File1", WRITE);       //  DENIED
+    checkCapabilityAccess(&p, "Charlie", "File2", WRITE);   //  DENIED
+
+    printf("\n-- Additional tests --\n");
+
+    checkACLAccess(&p, "Charlie", "File3", READ | WRITE);
+    checkCapabilityAccess(&p, "Charlie", "File3", READ | WRITE);
+
+    checkACLAccess(&p, "Bob", "File3", READ);
+    checkCapabilityAccess(&p, "Bob", "File3", READ);
+
+    freePolicy(&p);
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Adding a file to an in-memory image: inode and block allocation, tail
+// packing, root directory update and checksums. Shared by mkfs_adder and
+// mkfs_replay so the replay times the allocator the adder actually runs.
+//
+// The caller runs crc32_init() and crc32c_init() first.
+#ifndef MKFS_ADD_H
+#define MKFS_ADD_H
+
+#include <time.h>
+#include "mkfs_format.h"
+
+enum { ADD_OK = 0, ADD_NO_INODE, ADD_NO_SPACE, ADD_TOO_BIG, ADD_DIR_FULL, ADD_RESULTS };
+static const char* const ADD_RESULT_NAME[ADD_RESULTS] = {
+    "ok", "no free inode", "not enough free data blocks", "file needs more than 12 blocks",
+    "root directory full (no free dirent slots)"
+};
+
+// block of the checksum region that holds the CRC32C of data block rel
+static inline uint64_t csum_block_of(const superblock_t* sb, uint32_t bs, uint64_t rel){
+    return sb->inode_table_start + sb->inode_table_blocks + rel/(bs/4u);
+}
+
+// ========================== Tail packing ==========================
+// A packed tail is addressed from its inode as reserved_0 = fragment block,
+// reserved_1 = byte offset, reserved_2 = length. Free space inside fragment
+// blocks is not recorded anywhere; it is whatever the live tails leave
+// uncovered, so it is rebuilt here from the inode table.
+typedef struct {
+    uint32_t block, off, len;
+} tail_ref_t;
+
+static int tail_cmp(const void* a, const void* b){
+    const tail_ref_t* x = (const tail_ref_t*)a;
+    const tail_ref_t* y = (const tail_ref_t*)b;
+    if(x->block != y->block) return x->block < y->block ? -1 : 1;
+    return (x->off > y->off) - (x->off < y->off);
+}
+
+// first-fit gap of len bytes in an existing fragment block; 0 if none
+static uint32_t find_fragment(const inode_t* itbl, const uint8_t* ibm, uint64_t ninodes,
+                              uint32_t bs, uint32_t len, uint32_t* off){
+    tail_ref_t* t = (tail_ref_t*)malloc((ninodes ? ninodes : 1) * sizeof(tail_ref_t));
+    if(!t) die("malloc failed");
+    uint64_t n = 0;
+    for(uint64_t i=0;i<ninodes;i++){
+        if(!test_bit(ibm, i) || !itbl[i].reserved_0) continue;
+        t[n++] = (tail_ref_t){ itbl[i].reserved_0, itbl[i].reserved_1, itbl[i].reserved_2 };
+    }
+    qsort(t, n, sizeof(tail_ref_t), tail_cmp);
+
+    uint32_t found = 0;
+    for(uint64_t i=0;i<n && !found;){
+        uint32_t blk = t[i].block, end = 0;
+        for(; i<n && t[i].block == blk; i++){
+            if(!found && t[i].off >= end + len){ found = blk; *off = end; }
+            if(t[i].off + t[i].len > end) end = t[i].off + t[i].len;
+        }
+        if(!found && bs - end >= len){ found = blk; *off = end; }
+    }
+    free(t);
+    return found;
+}
+
+// ========================== Add (per block size) ==========================
+// Everything whose cost scales with the block size lives in add_file_bs().
+// It is force-inlined into add_file() once per supported block size, so in
+// every copy bs is a literal: idx*bs becomes a shift, bs/64 a constant and
+// the copy/CRC loops get fixed trip counts.
+//
+// All allocation happens before anything is written, so an add that fails
+// returns its ADD_* code and leaves the image exactly as it was. On success
+// every block that changed (superblock excepted) is passed to dirty, if given.
+#define BS_CASES(X) X(1024u) X(2048u) X(4096u) X(8192u) X(16384u) X(32768u) X(65536u)
+
+static inline __attribute__((always_inline))
+int add_file_bs(const uint32_t bs, uint8_t* img, const uint8_t* fbuf, uint64_t fsz, const char* name,
+                void (*dirty)(uint64_t), uint32_t* inum){
+    superblock_t* sb = (superblock_t*)img;
+    uint8_t* ibm = img + sb->inode_bitmap_start*bs;
+    uint8_t* dbm = img + sb->data_bitmap_start*bs;
+    inode_t* itbl = (inode_t*)(img + sb->inode_table_start*bs);
+    // data checksum region (if any) sits between the inode table and the data region
+    uint32_t* csum = (sb->flags & MVSF_FLAG_DATA_CSUM)
+        ? (uint32_t*)(img + (sb->inode_table_start + sb->inode_table_blocks)*bs) : NULL;
+    uint64_t drs = sb->data_region_start;
+
+    // with tail packing, a last partial block of up to half a block goes to a
+    // shared fragment block instead of getting a block of its own
+    uint32_t tail_len = ((sb->flags & MVSF_FLAG_TAILPACK) && fsz % bs <= bs/2) ? (uint32_t)(fsz % bs) : 0;
+    uint64_t need_blocks = (fsz - tail_len + bs - 1) / bs;
+    if(need_blocks > DIRECT_MAX) return ADD_TOO_BIG;
+
+    // -------- inode (#1 is the root, so start at index 1) --------
+    int64_t ino = -1;
+    for(uint64_t i=1;i<sb->inode_count;i++) if(!test_bit(ibm, i)){ ino = (int64_t)i; break; }
+    if(ino < 0) return ADD_NO_INODE;
+
+    // -------- first-fit data blocks (undone on any later failure) --------
+    uint64_t taken[DIRECT_MAX + 2];
+    int ntaken = 0;
+    uint32_t block_abs[DIRECT_MAX] = {0};
+    for(uint64_t i=0, found=0; i<sb->data_region_blocks && found<need_blocks; i++){
+        if(test_bit(dbm, i)) continue;
+        set_bit(dbm, i);
+        taken[ntaken++] = i;
+        block_abs[found++] = (uint32_t)(drs + i);
+    }
+    int rc = ADD_OK;
+    if((uint64_t)ntaken < need_blocks) rc = ADD_NO_SPACE;
+
+    uint32_t frag = 0, frag_off = 0;
+    int new_frag = 0;
+    if(rc == ADD_OK && tail_len){
+        frag = find_fragment(itbl, ibm, sb->inode_count, bs, tail_len, &frag_off);
+        if(!frag){
+            int64_t b = find_first_zero_bit(dbm, sb->data_region_blocks);
+            if(b < 0) rc = ADD_NO_SPACE;
+            else { set_bit(dbm, (uint64_t)b); taken[ntaken++] = (uint64_t)b; frag = (uint32_t)(drs + (uint64_t)b); new_frag = 1; }
+        }
+    }
+
+    // -------- free dirent in the root; small block sizes fill a block
+    // quickly, so grow the root by one block when all are full --------
+    inode_t* root = &itbl[0];
+    dirent64_t* slot = NULL;
+    uint8_t* rootblk = NULL;
+    int k = 0;
+    for(; rc == ADD_OK && k<DIRECT_MAX && root->direct[k] && !slot; k++){
+        rootblk = img + (uint64_t)root->direct[k]*bs;
+        dirent64_t* ents = (dirent64_t*)rootblk;
+        for(uint32_t i=0;i<bs/sizeof(dirent64_t); i++){
+            if(ents[i].inode_no == 0){ slot = &ents[i]; break; }
+        }
+    }
+    int grow = 0;
+    if(rc == ADD_OK && !slot){
+        int64_t b = find_first_zero_bit(dbm, sb->data_region_blocks);
+        if(k == DIRECT_MAX) rc = ADD_DIR_FULL;
+        else if(b < 0) rc = ADD_NO_SPACE;
+        else { set_bit(dbm, (uint64_t)b); taken[ntaken++] = (uint64_t)b; grow = 1; }
+    }
+    if(rc != ADD_OK){
+        for(int i=0;i<ntaken;i++) clear_bit(dbm, taken[i]);
+        return rc;
+    }
+
+    // -------- commit: data, tail, inode, dirent --------
+#define MARK(b) do{ if(dirty) dirty(b); }while(0)
+    set_bit(ibm, (uint64_t)ino);
+    MARK(sb->inode_bitmap_start + (uint64_t)ino/(bs*8u));
+    for(int i=0;i<ntaken;i++) MARK(sb->data_bitmap_start + taken[i]/(bs*8u));
+
+    for(uint64_t i=0;i<need_blocks;i++){
+        uint64_t off = i * bs;
+        uint64_t left = fsz - off;
+        size_t chunk = left > bs ? bs : (size_t)left;
+        uint8_t* dst = img + (uint64_t)block_abs[i]*bs;
+        MARK(block_abs[i]);
+        if(csum){
+            csum[block_abs[i] - drs] = crc32c_copy_block(dst, fbuf+off, chunk, bs);
+            MARK(csum_block_of(sb, bs, block_abs[i] - drs));
+            continue;
+        }
+        memset(dst, 0, bs);
+        memcpy(dst, fbuf+off, chunk);
+    }
+    if(tail_len){
+        uint8_t* fb = img + (uint64_t)frag*bs;
+        if(new_frag) memset(fb, 0, bs);
+        memcpy(fb + frag_off, fbuf + need_blocks*bs, tail_len);
+        MARK(frag);
+        if(csum){
+            csum[frag - drs] = crc32c_block(fb, bs);
+            MARK(csum_block_of(sb, bs, frag - drs));
+        }
+    }
+
+    uint64_t now = (uint64_t)time(NULL);
+    inode_t node = {0};
+    node.mode  = 0100000;  // regular file (octal)
+    node.links = 1;        // one directory entry
+    node.size_bytes = fsz;
+    node.atime = now; node.mtime = now; node.ctime = now;
+    for(uint64_t i=0;i<need_blocks;i++) node.direct[i] = block_abs[i];
+    node.reserved_0 = frag; node.reserved_1 = frag_off; node.reserved_2 = tail_len;
+    inode_crc_finalize(&node);
+    itbl[ino] = node;
+    MARK(sb->inode_table_start + (uint64_t)ino/(bs/INODE_SIZE));
+
+    if(grow){
+        root->direct[k] = (uint32_t)(drs + taken[ntaken-1]);
+        root->size_bytes += bs;
+        rootblk = img + (uint64_t)root->direct[k]*bs;
+        memset(rootblk, 0, bs);
+        slot = (dirent64_t*)rootblk;
+    }
+    dirent64_t de = {0};
+    de.inode_no = (uint32_t)(ino + 1);
+    de.type = 1; // file
+    size_t nl = strlen(name);
+    if(nl > sizeof(de.name)-1) nl = sizeof(de.name)-1;  // truncate, keeping the NUL
+    memcpy(de.name, name, nl);
+    dirent_checksum_finalize(&de);
+    *slot = de;
+    uint64_t dblk = (uint64_t)(rootblk - img)/bs;
+    MARK(dblk);
+    if(csum){
+        csum[dblk - drs] = crc32c_block(rootblk, bs);
+        MARK(csum_block_of(sb, bs, dblk - drs));
+    }
+
+    // Per project note: increase root links by 1 for new file (though not typical for POSIX)
+    root->links += 1;
+    root->mtime = now; root->ctime = now;
+    inode_crc_finalize(root);
+    MARK(sb->inode_table_start);
+#undef MARK
+
+    sb->mtime_epoch = now;
+    superblock_crc_finalize(sb);
+    *inum = (uint32_t)(ino + 1);
+    return ADD_OK;
+}
+
+static int add_file(uint8_t* img, const uint8_t* fbuf, uint64_t fsz, const char* name,
+                    void (*dirty)(uint64_t), uint32_t* inum){
+    switch(((const superblock_t*)img)->block_size){
+#define ADD_CASE(N) case N: return add_file_bs(N, img, fbuf, fsz, name, dirty, inum);
+    BS_CASES(ADD_CASE)
+#undef ADD_CASE
+    }
+    die("unsupported block size");
+    return ADD_OK;
+}
+
+#endif
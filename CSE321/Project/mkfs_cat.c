@@ -0,0 +1,102 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_cat.c -o mkfs_cat
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "mkfs_format.h"
+
+// ========================== Utils ==========================
+static int pread_full(int fd, void* buf, size_t n, off_t off){
+    uint8_t* p = (uint8_t*)buf;
+    while(n){
+        ssize_t r = pread(fd, p, n, off);
+        if(r <= 0){ if(r < 0 && errno == EINTR) continue; return 0; }
+        p += r; n -= (size_t)r; off += r;
+    }
+    return 1;
+}
+
+#include "mkfs_read.h"
+
+static int write_out(void* ctx, const uint8_t* p, size_t n){
+    return fwrite(p, 1, n, (FILE*)ctx) == n;
+}
+
+// ========================== Main ==========================
+// Reads one file out of an image. Only the blocks actually touched are
+// read; when the image has a data checksum region each block is checked
+// against its CRC32C as it is read (lazy verification).
+int main(int argc, char** argv) {
+    crc32c_init();
+
+    const char* image = NULL;
+    const char* name = NULL;
+    const char* output = NULL;
+    int verify = 1;
+    const char* trace = NULL;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--image") && i+1<argc) image=argv[++i];
+        else if(!strcmp(argv[i],"--file") && i+1<argc) name=argv[++i];
+        else if(!strcmp(argv[i],"--output") && i+1<argc) output=argv[++i];
+        else if(!strcmp(argv[i],"--no-verify")) verify=0;
+        else if(!strcmp(argv[i],"--trace") && i+1<argc) trace=argv[++i];
+        else {
+            fprintf(stderr,"Usage: %s --image fs.img --file <name> [--output out] [--no-verify] [--trace ops.trace]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!image || !name) die("missing required arguments");
+
+    int fd = open(image, O_RDONLY);
+    if(fd < 0){ perror("open image"); return 1; }
+
+    superblock_t sb;
+    if(!pread_full(fd, &sb, sizeof(sb), 0)) die("read superblock failed");
+    uint32_t bs = sb.block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || sb.magic != 0x4D565346u) die("invalid superblock");
+    // read_file() trusts the layout fields, so make sure they stay inside the file
+    struct stat st;
+    if(fstat(fd, &st) != 0){ perror("fstat"); return 1; }
+    uint64_t nblocks = (uint64_t)st.st_size / bs;
+    if(sb.inode_table_start >= nblocks || sb.inode_table_blocks > nblocks - sb.inode_table_start ||
+       sb.inode_count > sb.inode_table_blocks * (bs / INODE_SIZE) ||
+       sb.data_region_start > nblocks || sb.data_region_blocks > nblocks - sb.data_region_start ||
+       sb.inode_table_start + sb.inode_table_blocks > sb.data_region_start)
+        die("superblock layout does not fit the image");
+    if(!(sb.flags & MVSF_FLAG_DATA_CSUM)) verify = 0;
+
+    // mapped, so only the blocks the file touches are ever read from disk
+    size_t map_len = (size_t)((sb.data_region_start + sb.data_region_blocks) * bs);
+    const uint8_t* img = (const uint8_t*)mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(img == MAP_FAILED){ perror("mmap"); return 1; }
+
+    FILE* fo = output ? fopen(output, "wb") : stdout;
+    if(!fo){ perror("fopen output"); return 1; }
+
+    uint64_t size = 0;
+    uint32_t bad = 0;
+    int rc = read_file(img, name, verify, write_out, fo, &size, &bad);
+    if(rc == READ_OUTPUT){ perror("fwrite"); return 1; }
+    if(rc == READ_BAD_CSUM){
+        fprintf(stderr, "Error: block %u of '%s' fails its checksum\n", bad, name);
+        return 1;
+    }
+    if(rc != READ_OK) die(READ_RESULT_NAME[rc]);
+    if(output && fclose(fo) != 0){ perror("fclose"); return 1; }
+
+    if(trace) trace_append(trace, (trace_rec_t){ TRACE_READ, 0, 0, bs, size, 0 }, name);
+
+    munmap((void*)img, map_len);
+    close(fd);
+    return 0;
+}
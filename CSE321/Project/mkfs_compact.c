@@ -0,0 +1,248 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_compact.c -o mkfs_compact
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+
+#include "mkfs_format.h"
+
+// ========================== Main ==========================
+// Rewrites an image so that:
+//   * in-use inodes occupy the lowest inode numbers (root stays #1),
+//   * every inode's direct[] blocks form one contiguous run, laid out in
+//     inode order right after the start of the data region,
+//   * packed file tails are refilled, in inode order, into as few fragment
+//     blocks as next-fit allows, placed after all whole blocks,
+//   * root dirents point at the renumbered inodes and are packed to the front,
+//   * the free tail of the data region is cut off (unless --keep-size).
+// The new image is assembled in a separate buffer, so relocation never has
+// to worry about a destination block still holding someone else's data.
+int main(int argc, char** argv) {
+    crc32_init();
+    crc32c_init();
+
+    const char* input = NULL;
+    const char* output = NULL;
+    int keep_size = 0;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--input") && i+1<argc) input=argv[++i];
+        else if(!strcmp(argv[i],"--output") && i+1<argc) output=argv[++i];
+        else if(!strcmp(argv[i],"--keep-size")) keep_size=1;
+        else {
+            fprintf(stderr,"Usage: %s --input in.img --output out.img [--keep-size]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!input || !output) die("missing required arguments");
+
+    // read whole input image
+    FILE* fi = fopen(input, "rb");
+    if(!fi){ perror("fopen input"); return 1; }
+    fseeko(fi, 0, SEEK_END);
+    off_t fsz = ftello(fi);
+    if(fsz <= 0){ fclose(fi); die("bad image size"); }
+    fseeko(fi, 0, SEEK_SET);
+
+    uint8_t* img = (uint8_t*)malloc((size_t)fsz);
+    if(!img){ fclose(fi); die("malloc failed"); }
+    if(fread(img, 1, (size_t)fsz, fi) != (size_t)fsz){ fclose(fi); free(img); die("read image failed"); }
+    fclose(fi);
+
+    if((size_t)fsz < BS_MIN) { free(img); die("image too small"); }
+    superblock_t* sb = (superblock_t*)img;
+    uint32_t bs = sb->block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || sb->magic != 0x4D565346u){
+        free(img); die("invalid superblock");
+    }
+    if((uint64_t)fsz != sb->total_blocks * bs){
+        free(img); die("image size mismatch");
+    }
+
+    const uint8_t* ibm = img + sb->inode_bitmap_start*bs;
+    const inode_t* itbl = (const inode_t*)(img + sb->inode_table_start*bs);
+    uint64_t max_inodes = sb->inode_count;
+    uint64_t drs = sb->data_region_start;
+    uint64_t drb = sb->data_region_blocks;
+
+    // -------- renumber inodes: old index -> new index --------
+    uint32_t* remap = (uint32_t*)calloc(max_inodes, sizeof(uint32_t)); // new inode no, 0 = free
+    if(!remap){ free(img); die("calloc failed"); }
+    if(!test_bit(ibm, 0)){ free(remap); free(img); die("root inode not allocated"); }
+    uint64_t live_inodes = 0;
+    for(uint64_t i=0;i<max_inodes;i++){
+        if(test_bit(ibm, i)) remap[i] = (uint32_t)(++live_inodes);
+    }
+
+    // -------- count data blocks in use (as referenced by live inodes) --------
+    uint64_t used_blocks = 0;
+    for(uint64_t i=0;i<max_inodes;i++){
+        if(!remap[i]) continue;
+        for(int k=0;k<DIRECT_MAX;k++){
+            uint32_t b = itbl[i].direct[k];
+            if(!b) continue;
+            if(b < drs || b >= drs + drb){ free(remap); free(img); die("inode points outside data region"); }
+            used_blocks++;
+        }
+    }
+    // fragment blocks needed to repack the tails (next-fit, inode order)
+    uint64_t frag_blocks = 0, frag_fill = bs;
+    for(uint64_t i=0;i<max_inodes;i++){
+        if(!remap[i] || !itbl[i].reserved_0) continue;
+        uint32_t fb = itbl[i].reserved_0, len = itbl[i].reserved_2;
+        if(fb < drs || fb >= drs + drb || len == 0 || (uint64_t)itbl[i].reserved_1 + len > bs){
+            free(remap); free(img); die("inode has a bad tail reference");
+        }
+        if(frag_fill + len > bs){ frag_blocks++; frag_fill = 0; }
+        frag_fill += len;
+    }
+    used_blocks += frag_blocks;
+
+    uint64_t new_drb = keep_size ? drb : used_blocks;
+    if(new_drb == 0) new_drb = 1; // root always owns a block, but never emit an empty region
+    // a data bitmap that mkfs_resize moved past the data region follows it
+    int dbm_in_tail = sb->data_bitmap_start >= drs;
+    if(dbm_in_tail && new_drb > sb->data_bitmap_blocks * bs * 8ull) new_drb = sb->data_bitmap_blocks * bs * 8ull;
+    uint64_t new_total = drs + new_drb + (dbm_in_tail ? sb->data_bitmap_blocks : 0);
+
+    uint8_t* out = (uint8_t*)calloc(1, new_total * bs);
+    if(!out){ free(remap); free(img); die("calloc failed"); }
+
+    // metadata blocks (superblock, bitmaps, inode table) are rebuilt in place
+    memcpy(out, img, drs * bs);
+    superblock_t* nsb = (superblock_t*)out;
+    if(dbm_in_tail) nsb->data_bitmap_start = drs + new_drb;
+    uint8_t* nibm = out + nsb->inode_bitmap_start*bs;
+    uint8_t* ndbm = out + nsb->data_bitmap_start*bs;
+    inode_t* ntbl = (inode_t*)(out + nsb->inode_table_start*bs);
+    memset(nibm, 0, nsb->inode_bitmap_blocks*bs);
+    memset(ndbm, 0, nsb->data_bitmap_blocks*bs);
+    memset(ntbl, 0, nsb->inode_table_blocks*bs);
+
+    // data checksums travel with their blocks
+    const uint32_t* csum = NULL;
+    uint32_t* ncsum = NULL;
+    if(sb->flags & MVSF_FLAG_DATA_CSUM){
+        uint64_t cs = sb->inode_table_start + sb->inode_table_blocks;
+        csum = (const uint32_t*)(img + cs*bs);
+        ncsum = (uint32_t*)(out + cs*bs);
+        memset(ncsum, 0, (drs - cs)*bs);
+    }
+
+    // -------- relocate data: one contiguous run per inode, inode order --------
+    uint64_t next = 0, moved = 0;
+    for(uint64_t i=0;i<max_inodes;i++){
+        if(!remap[i]) continue;
+        inode_t node = itbl[i];
+        for(int k=0;k<DIRECT_MAX;k++){
+            uint32_t b = node.direct[k];
+            if(!b) continue;
+            uint64_t nb = drs + next;
+            memcpy(out + nb*bs, img + (uint64_t)b*bs, bs);
+            set_bit(ndbm, next);
+            if(ncsum) ncsum[next] = csum[b - drs];
+            if(nb != b) moved++;
+            node.direct[k] = (uint32_t)nb;
+            next++;
+        }
+        uint64_t ni = remap[i] - 1;
+        set_bit(nibm, ni);
+        inode_crc_finalize(&node);
+        ntbl[ni] = node;
+    }
+
+    // -------- repack tails behind the whole blocks --------
+    uint64_t frag = 0, fill = bs;
+    for(uint64_t i=0;i<max_inodes;i++){
+        if(!remap[i] || !itbl[i].reserved_0) continue;
+        inode_t* node = &ntbl[remap[i] - 1];
+        uint32_t len = node->reserved_2;
+        if(fill + len > bs){
+            frag = drs + next++;
+            set_bit(ndbm, frag - drs);
+            fill = 0;
+        }
+        memcpy(out + frag*bs + fill, img + (uint64_t)node->reserved_0*bs + node->reserved_1, len);
+        node->reserved_0 = (uint32_t)frag;
+        node->reserved_1 = (uint32_t)fill;
+        fill += len;
+        inode_crc_finalize(node);
+    }
+    if(ncsum)
+        for(uint64_t b=next-frag_blocks;b<next;b++) ncsum[b] = crc32c_block(out + (drs + b)*bs, bs);
+
+    // -------- rewrite root dirents with the new inode numbers --------
+    inode_t* root = &ntbl[0];
+    dirent64_t* packed = NULL;
+    uint64_t nents = 0, ents_per_blk = bs / sizeof(dirent64_t);
+    for(int k=0;k<DIRECT_MAX;k++) if(root->direct[k]) nents += ents_per_blk;
+    packed = (dirent64_t*)calloc(nents ? nents : 1, sizeof(dirent64_t));
+    if(!packed){ free(out); free(remap); free(img); die("calloc failed"); }
+
+    uint64_t live_ents = 0;
+    for(int k=0;k<DIRECT_MAX;k++){
+        if(!root->direct[k]) continue;
+        const dirent64_t* ents = (const dirent64_t*)(out + (uint64_t)root->direct[k]*bs);
+        for(uint64_t e=0;e<ents_per_blk;e++){
+            if(ents[e].inode_no == 0) continue;
+            uint64_t old = (uint64_t)ents[e].inode_no - 1;
+            if(old >= max_inodes || !remap[old]){
+                fprintf(stderr, "Warning: dropping dirent '%.58s' (inode #%u not allocated)\n",
+                        ents[e].name, ents[e].inode_no);
+                continue;
+            }
+            dirent64_t de = ents[e];
+            de.inode_no = remap[old];
+            dirent_checksum_finalize(&de);
+            packed[live_ents++] = de;
+        }
+    }
+    uint64_t e = 0;
+    for(int k=0;k<DIRECT_MAX;k++){
+        if(!root->direct[k]) continue;
+        dirent64_t* ents = (dirent64_t*)(out + (uint64_t)root->direct[k]*bs);
+        for(uint64_t j=0;j<ents_per_blk;j++,e++){
+            if(e < live_ents) ents[j] = packed[e];
+            else memset(&ents[j], 0, sizeof(dirent64_t));
+        }
+        if(ncsum) ncsum[root->direct[k] - drs] = crc32c_block((const uint8_t*)ents, bs);
+    }
+    free(packed);
+
+    // root links follow the adder's convention: one per dirent (".", ".." and each file)
+    root->links = (uint16_t)live_ents;
+    inode_crc_finalize(root);
+
+    uint64_t now = (uint64_t)time(NULL);
+    nsb->total_blocks = new_total;
+    nsb->data_region_blocks = new_drb;
+    nsb->mtime_epoch = now;
+    // every block may have moved; a hash tree is rebuilt with mkfs_merkle --build
+    int had_tree = (nsb->flags & MVSF_FLAG_MERKLE) != 0;
+    nsb->flags &= ~MVSF_FLAG_MERKLE;
+    memset(out + MERKLE_ROOT_OFF, 0, 32);
+    superblock_crc_finalize(nsb);
+
+    // -------- write output image --------
+    FILE* fo = fopen(output, "wb");
+    if(!fo){ perror("fopen output"); free(out); free(remap); free(img); return 1; }
+    size_t wr = fwrite(out, 1, new_total*bs, fo);
+    if(wr != new_total*bs){ perror("fwrite"); fclose(fo); free(out); free(remap); free(img); return 1; }
+    fclose(fo);
+
+    printf("Compacted image: %s -> %s\n", input, output);
+    printf("Inodes in use: %" PRIu64 ", data blocks in use: %" PRIu64 " (%" PRIu64 " relocated)\n",
+           live_inodes, used_blocks, moved);
+    printf("Blocks: %" PRIu64 " -> %" PRIu64 "\n", sb->total_blocks, new_total);
+    if(had_tree) printf("Hash tree dropped (rerun mkfs_merkle --build)\n");
+
+    free(out);
+    free(remap);
+    free(img);
+    return 0;
+}
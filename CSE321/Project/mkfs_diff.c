@@ -0,0 +1,203 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_diff.c -o mkfs_diff
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mkfs_format.h"
+
+#define PATCH_MAGIC 0x5044564Du   // "MVDP"
+
+#pragma pack(push,1)
+typedef struct {
+    // patch file header, followed by extents
+    uint32_t magic;           // "MVDP"
+    uint32_t version;         // 2
+    uint32_t block_size;
+    uint32_t base_meta_crc;   // crc32 of the base's blocks [0, data_region_start)
+    uint32_t target_meta_crc; // same, for the image the patch produces
+    uint32_t payload_crc;     // crc32 of everything after this header
+    uint64_t base_blocks;
+    uint64_t target_blocks;
+    uint64_t extent_count;
+} patch_hdr_t;
+
+typedef struct {
+    // one run of changed blocks; count*block_size payload bytes follow
+    uint64_t start;
+    uint32_t count;
+} patch_extent_t;
+#pragma pack(pop)
+_Static_assert(sizeof(patch_hdr_t) == 48, "patch header size mismatch");
+_Static_assert(sizeof(patch_extent_t) == 12, "patch extent size mismatch");
+
+// ========================== Utils ==========================
+
+// Maps an image read-only and sanity-checks its superblock.
+static const uint8_t* map_image(const char* path, uint64_t* nblocks){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){ perror(path); exit(1); }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)BS_MIN){ close(fd); die("image too small"); }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){ perror("mmap"); exit(1); }
+    const superblock_t* sb = (const superblock_t*)p;
+    uint32_t bs = sb->block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || sb->magic != 0x4D565346u) die("invalid superblock");
+    if((uint64_t)st.st_size != sb->total_blocks * bs) die("image size mismatch");
+    posix_madvise(p, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    *nblocks = sb->total_blocks;
+    return (const uint8_t*)p;
+}
+
+// Branch-free block compare: XOR/OR-reduce 64-bit words with no early exit,
+// which GCC turns into straight SSE2/AVX2 (or NEON) code at -O2/-O3.
+static inline int block_equal(const uint8_t* a, const uint8_t* b, uint32_t bs){
+    const uint64_t* x = (const uint64_t*)a;
+    const uint64_t* y = (const uint64_t*)b;
+    uint64_t acc = 0;
+    for(unsigned i=0;i<bs/8;i++) acc |= x[i] ^ y[i];
+    return acc == 0;
+}
+static inline int block_zero(const uint8_t* a, uint32_t bs){
+    const uint64_t* x = (const uint64_t*)a;
+    uint64_t acc = 0;
+    for(unsigned i=0;i<bs/8;i++) acc |= x[i];
+    return acc == 0;
+}
+
+// Inode-table blocks: any differing stored inode CRC proves the block changed
+// without touching the remaining 120 bytes of each inode.
+static inline int inode_block_crc_differs(const uint8_t* a, const uint8_t* b, uint32_t bs){
+    const inode_t* x = (const inode_t*)a;
+    const inode_t* y = (const inode_t*)b;
+    for(unsigned i=0;i<bs/INODE_SIZE;i++) if(x[i].inode_crc != y[i].inode_crc) return 1;
+    return 0;
+}
+
+// ========================== Compare (per block size) ==========================
+// The scan is force-inlined once per supported block size, so the compare
+// loops above run with a constant trip count and b*bs is a shift.
+#define BS_CASES(X) X(1024u) X(2048u) X(4096u) X(8192u) X(16384u) X(32768u) X(65536u)
+
+static inline __attribute__((always_inline))
+void diff_blocks_bs(const uint32_t bs, const uint8_t* oimg, uint64_t ob, const uint8_t* nimg, uint64_t nb,
+                    FILE* fo, uint64_t* extents_out, uint64_t* changed_out, uint32_t* crc_out){
+    const superblock_t* osb = (const superblock_t*)oimg;
+    const superblock_t* nsb = (const superblock_t*)nimg;
+    uint64_t its = nsb->inode_table_start, ite = its + nsb->inode_table_blocks;
+    int same_itbl = osb->inode_table_start == its && osb->inode_table_blocks == nsb->inode_table_blocks;
+
+    uint64_t extents = 0, changed = 0;
+    uint64_t run_start = 0, run_len = 0;
+    uint32_t crc = 0;
+    for(uint64_t b=0;b<=nb;b++){
+        int diff = 0;
+        if(b < nb){
+            const uint8_t* nblk = nimg + b*bs;
+            if(b >= ob) diff = !block_zero(nblk, bs);      // patch_apply zero-extends
+            else if(same_itbl && b >= its && b < ite && inode_block_crc_differs(oimg + b*bs, nblk, bs)) diff = 1;
+            else diff = !block_equal(oimg + b*bs, nblk, bs);
+        }
+        if(diff){
+            if(run_len == 0) run_start = b;
+            run_len++;
+            changed++;
+            if(run_len < UINT32_MAX) continue;
+        }
+        if(run_len){
+            patch_extent_t ext = { run_start, (uint32_t)run_len };
+            if(fwrite(&ext, sizeof(ext), 1, fo) != 1 ||
+               fwrite(nimg + run_start*bs, bs, run_len, fo) != run_len){
+                perror("fwrite"); exit(1);
+            }
+            crc = crc32_update(crc, &ext, sizeof(ext));
+            crc = crc32_update(crc, nimg + run_start*bs, (size_t)(run_len*bs));
+            extents++;
+            run_len = 0;
+        }
+    }
+    *extents_out = extents;
+    *changed_out = changed;
+    *crc_out = crc;
+}
+
+static void diff_blocks(uint32_t bs, const uint8_t* oimg, uint64_t ob, const uint8_t* nimg, uint64_t nb,
+                        FILE* fo, uint64_t* extents, uint64_t* changed, uint32_t* crc){
+    switch(bs){
+#define DIFF_CASE(N) case N: diff_blocks_bs(N, oimg, ob, nimg, nb, fo, extents, changed, crc); return;
+    BS_CASES(DIFF_CASE)
+#undef DIFF_CASE
+    }
+    die("unsupported block size");
+}
+
+// ========================== Main ==========================
+int main(int argc, char** argv) {
+    crc32_init();
+
+    const char* old_path = NULL;
+    const char* new_path = NULL;
+    const char* output = NULL;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--old") && i+1<argc) old_path=argv[++i];
+        else if(!strcmp(argv[i],"--new") && i+1<argc) new_path=argv[++i];
+        else if(!strcmp(argv[i],"--output") && i+1<argc) output=argv[++i];
+        else {
+            fprintf(stderr,"Usage: %s --old base.img --new target.img --output delta.patch\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!old_path || !new_path || !output) die("missing required arguments");
+
+    uint64_t ob = 0, nb = 0;
+    const uint8_t* oimg = map_image(old_path, &ob);
+    const uint8_t* nimg = map_image(new_path, &nb);
+    const superblock_t* osb = (const superblock_t*)oimg;
+    const superblock_t* nsb = (const superblock_t*)nimg;
+    uint32_t bs = osb->block_size;
+    if(nsb->block_size != bs) die("images use different block sizes");
+
+    FILE* fo = fopen(output, "wb");
+    if(!fo){ perror("fopen output"); return 1; }
+
+    patch_hdr_t hdr = {0};
+    hdr.magic = PATCH_MAGIC;
+    hdr.version = 2;
+    hdr.block_size = bs;
+    hdr.base_meta_crc = crc32(oimg, osb->data_region_start * bs);
+    hdr.target_meta_crc = crc32(nimg, nsb->data_region_start * bs);
+    hdr.base_blocks = ob;
+    hdr.target_blocks = nb;
+    if(fwrite(&hdr, sizeof(hdr), 1, fo) != 1){ perror("fwrite"); fclose(fo); return 1; }
+
+    uint64_t extents = 0, changed = 0;
+    uint32_t payload_crc = 0;
+    diff_blocks(bs, oimg, ob, nimg, nb, fo, &extents, &changed, &payload_crc);
+
+    hdr.extent_count = extents;
+    hdr.payload_crc = payload_crc;
+    if(fseeko(fo, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, fo) != 1){
+        perror("fwrite header"); fclose(fo); return 1;
+    }
+    if(fclose(fo) != 0){ perror("fclose"); return 1; }
+
+    printf("Patch: %s\n", output);
+    printf("Changed blocks: %" PRIu64 " of %" PRIu64 " in %" PRIu64 " extent(s), %" PRIu64 " bytes\n",
+           changed, nb, extents,
+           (uint64_t)sizeof(patch_hdr_t) + extents*sizeof(patch_extent_t) + changed*bs);
+
+    munmap((void*)oimg, ob*bs);
+    munmap((void*)nimg, nb*bs);
+    return 0;
+}
@@ -0,0 +1,370 @@
+// MiniVSFS on-disk format and the helpers every mkfs_* tool shares: the
+// superblock, inode and dirent layouts, the hash tree side file and the
+// operation trace, plus CRC32 (metadata), CRC32C (data blocks), SHA-256
+// (hash tree), the bitmap helpers and die().
+//
+// Each tool is still a single translation unit built as on its Build: line,
+// so everything here is static and a tool only pays for what it calls.
+// Call crc32_init() / crc32c_init() before using the matching CRC.
+#ifndef MKFS_FORMAT_H
+#define MKFS_FORMAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#define BS_MIN 1024u
+#define BS_MAX 65536u
+#define INODE_SIZE 128u
+#define ROOT_INO 1u
+#define DIRECT_MAX 12
+
+// superblock flags
+#define MVSF_FLAG_DATA_CSUM 0x1u  // CRC32C per data block, stored between inode table and data region
+#define MVSF_FLAG_MERKLE    0x2u  // SHA-256 tree root follows the superblock struct in block 0 (mkfs_merkle)
+#define MVSF_FLAG_TAILPACK  0x4u  // file tails may share fragment blocks (see inode reserved_0..2)
+
+// ========================== On-disk structures ==========================
+
+#pragma pack(push, 1)
+typedef struct {
+    // Superblock fields per spec (little-endian on disk)
+    uint32_t magic;               // 0x4D565346 "MVSF"
+    uint32_t version;             // 1
+    uint32_t block_size;          // 4096
+
+    uint64_t total_blocks;
+    uint64_t inode_count;
+
+    uint64_t inode_bitmap_start;
+    uint64_t inode_bitmap_blocks;
+
+    uint64_t data_bitmap_start;
+    uint64_t data_bitmap_blocks;
+
+    uint64_t inode_table_start;
+    uint64_t inode_table_blocks;
+
+    uint64_t data_region_start;
+    uint64_t data_region_blocks;
+
+    uint64_t root_inode;          // 1
+
+    uint64_t mtime_epoch;         // build time
+
+    uint32_t flags;               // MVSF_FLAG_* bits
+
+    // THIS FIELD SHOULD STAY AT THE END
+    uint32_t checksum;            // crc32(block 0 up to block_size-4)
+} superblock_t;
+#pragma pack(pop)
+_Static_assert(sizeof(superblock_t) == 116, "superblock must fit in one block");
+#define MERKLE_ROOT_OFF sizeof(superblock_t)   // 32-byte root, covered by the superblock CRC
+
+#pragma pack(push,1)
+typedef struct {
+    // inode (120-byte header + 8-byte crc = 128)
+    uint16_t mode;        // dir=040000, file=010000 (octal)
+    uint16_t links;       // root starts with 2 (., ..)
+
+    uint32_t uid;         // 0
+    uint32_t gid;         // 0
+
+    uint64_t size_bytes;
+
+    uint64_t atime;
+    uint64_t mtime;
+    uint64_t ctime;
+
+    uint32_t direct[DIRECT_MAX]; // absolute block numbers (0=unused)
+
+    // tail packing: the last partial block of a file may sit in a fragment
+    // block shared with other tails; direct[] then holds only whole blocks
+    uint32_t reserved_0;  // fragment block of the tail (0 = no tail)
+    uint32_t reserved_1;  // byte offset of the tail in that block
+    uint32_t reserved_2;  // tail length in bytes
+    uint32_t proj_id;     // set to 0 or group id if desired
+    uint32_t uid16_gid16; // 0
+    uint64_t xattr_ptr;   // 0
+
+    // THIS FIELD SHOULD STAY AT THE END
+    uint64_t inode_crc;   // low 4 bytes store crc32 of bytes [0..119]; high 4 bytes 0
+} inode_t;
+#pragma pack(pop)
+_Static_assert(sizeof(inode_t)==INODE_SIZE, "inode size mismatch");
+
+#pragma pack(push,1)
+typedef struct {
+    // dirent64: total 64 bytes
+    uint32_t inode_no;     // 0 if free
+    uint8_t  type;         // 1=file, 2=dir
+    char     name[58];     // zero-padded
+    uint8_t  checksum;     // XOR of bytes 0..62
+} dirent64_t;
+#pragma pack(pop)
+_Static_assert(sizeof(dirent64_t)==64, "dirent size mismatch");
+
+// ========================== Hash tree side file ==========================
+#define MERKLE_MAGIC 0x4B4D564Du  // "MVMK"
+
+#pragma pack(push,1)
+typedef struct {
+    // side file <image>.mkl: this header, then 2*leaves 32-byte nodes in
+    // heap order (node 1 is the root, children of i are 2i and 2i+1, node 0
+    // unused). Leaf j covers block j+1; block 0 holds the root itself and is
+    // protected by the superblock CRC. Leaves past the last block are zero.
+    uint32_t magic;           // "MVMK"
+    uint32_t version;         // 1
+    uint32_t block_size;
+    uint32_t reserved;
+    uint64_t total_blocks;
+    uint64_t leaves;          // power of two, >= total_blocks-1
+} merkle_hdr_t;
+#pragma pack(pop)
+_Static_assert(sizeof(merkle_hdr_t) == 32, "hash tree header size mismatch");
+
+// ========================== Trace format ==========================
+// A trace is a trace_hdr_t followed by records, each a trace_rec_t plus
+// name_len name bytes. mkfs_builder, mkfs_adder and mkfs_cat append to it
+// when given --trace, and mkfs_replay runs it back against an image:
+//   FORMAT  block_size, arg0 = size_kib, arg1 = inodes | superblock flags << 32
+//   ADD     arg0 = file size, name
+//   READ    arg0 = file size, name
+#define TRACE_MAGIC 0x5254564Du   // "MVTR"
+enum { TRACE_FORMAT = 1, TRACE_ADD = 2, TRACE_READ = 3, TRACE_OPS };
+
+#pragma pack(push,1)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} trace_hdr_t;
+
+typedef struct {
+    uint8_t  op;
+    uint8_t  name_len;        // name bytes follow the record
+    uint16_t reserved;
+    uint32_t block_size;
+    uint64_t arg0;            // FORMAT: size_kib; ADD/READ: file size
+    uint64_t arg1;            // FORMAT: inodes | flags << 32
+} trace_rec_t;
+#pragma pack(pop)
+_Static_assert(sizeof(trace_rec_t) == 24, "trace record size mismatch");
+
+static inline void trace_append(const char* path, trace_rec_t rec, const char* name){
+    FILE* ft = fopen(path, "ab");
+    if(!ft){ perror("fopen trace"); return; }
+    size_t n = name ? strlen(name) : 0;
+    if(n > 255) n = 255;
+    rec.name_len = (uint8_t)n;
+    fseek(ft, 0, SEEK_END);
+    if(ftell(ft) == 0){
+        trace_hdr_t h = { TRACE_MAGIC, 1 };
+        fwrite(&h, sizeof(h), 1, ft);
+    }
+    if(fwrite(&rec, sizeof(rec), 1, ft) != 1 || (n && fwrite(name, 1, n, ft) != n)) perror("write trace");
+    fclose(ft);
+}
+
+// ========================== CRC helpers (given) =========================
+static uint32_t CRC32_TAB[256];
+static inline void crc32_init(void){
+    for (uint32_t i=0;i<256;i++){
+        uint32_t c=i;
+        for(int j=0;j<8;j++) c = (c&1)?(0xEDB88320u^(c>>1)):(c>>1);
+        CRC32_TAB[i]=c;
+    }
+}
+static inline uint32_t crc32(const void* data, size_t n){
+    const uint8_t* p=(const uint8_t*)data; uint32_t c=0xFFFFFFFFu;
+    for(size_t i=0;i<n;i++) c = CRC32_TAB[(c^p[i])&0xFF] ^ (c>>8);
+    return c ^ 0xFFFFFFFFu;
+}
+// crc32 over pieces: start with c = 0, pass the previous result back in
+static inline uint32_t crc32_update(uint32_t c, const void* data, size_t n){
+    const uint8_t* p=(const uint8_t*)data; c ^= 0xFFFFFFFFu;
+    for(size_t i=0;i<n;i++) c = CRC32_TAB[(c^p[i])&0xFF] ^ (c>>8);
+    return c ^ 0xFFFFFFFFu;
+}
+static inline uint32_t superblock_crc_finalize(superblock_t *sb) {
+    sb->checksum = 0;
+    uint32_t s = crc32((void *) sb, sb->block_size - 4);
+    sb->checksum = s;
+    return s;
+}
+static inline void inode_crc_finalize(inode_t* ino){
+    uint8_t tmp[INODE_SIZE]; memcpy(tmp, ino, INODE_SIZE);
+    memset(&tmp[120], 0, 8);
+    uint32_t c = crc32(tmp, 120);
+    ino->inode_crc = (uint64_t)c;
+}
+static inline void dirent_checksum_finalize(dirent64_t* de) {
+    const uint8_t* p = (const uint8_t*)de;
+    uint8_t x = 0;
+    for (int i = 0; i < 63; i++) x ^= p[i];
+    de->checksum = x;
+}
+
+// ========================== CRC32C (data blocks) =========================
+// Castagnoli CRC, slice-by-8; uses the SSE4.2 crc32 instruction when built
+// with -msse4.2. Data-block checksums live in their own region (one uint32_t
+// per data block) so the metadata CRCs above stay exactly as specified.
+static uint32_t CRC32C_TAB[8][256];
+static inline void crc32c_init(void){
+    for (uint32_t i=0;i<256;i++){
+        uint32_t c=i;
+        for(int j=0;j<8;j++) c = (c&1)?(0x82F63B78u^(c>>1)):(c>>1);
+        CRC32C_TAB[0][i]=c;
+    }
+    for (uint32_t i=0;i<256;i++)
+        for(int k=1;k<8;k++) CRC32C_TAB[k][i] = (CRC32C_TAB[k-1][i]>>8) ^ CRC32C_TAB[0][CRC32C_TAB[k-1][i]&0xFF];
+}
+static inline uint32_t crc32c_u64(uint32_t c, uint64_t v){
+#if defined(__SSE4_2__)
+    return (uint32_t)_mm_crc32_u64(c, v);
+#else
+    uint32_t lo = c ^ (uint32_t)v, hi = (uint32_t)(v >> 32);
+    return CRC32C_TAB[7][lo&0xFF] ^ CRC32C_TAB[6][(lo>>8)&0xFF] ^ CRC32C_TAB[5][(lo>>16)&0xFF] ^ CRC32C_TAB[4][lo>>24] ^
+           CRC32C_TAB[3][hi&0xFF] ^ CRC32C_TAB[2][(hi>>8)&0xFF] ^ CRC32C_TAB[1][(hi>>16)&0xFF] ^ CRC32C_TAB[0][hi>>24];
+#endif
+}
+static inline uint32_t crc32c_u8(uint32_t c, uint8_t b){
+    return CRC32C_TAB[0][(c ^ b) & 0xFF] ^ (c >> 8);
+}
+// crc32c of one whole block
+static inline uint32_t crc32c_block(const uint8_t* p, uint32_t bs){
+    uint32_t c = 0xFFFFFFFFu;
+    for(size_t i=0;i<bs;i+=8){ uint64_t v; memcpy(&v, p+i, 8); c = crc32c_u64(c, v); }
+    return c ^ 0xFFFFFFFFu;
+}
+// Fused copy + checksum: copies n (<= bs) bytes into a block, zero-fills the
+// rest and returns the crc32c of the whole block. Each word is loaded once
+// and feeds both the store and the CRC, so data is touched a single time.
+static inline uint32_t crc32c_copy_block(uint8_t* dst, const uint8_t* src, size_t n, uint32_t bs){
+    uint32_t c = 0xFFFFFFFFu;
+    size_t i = 0;
+    for(; i+8<=n; i+=8){
+        uint64_t v; memcpy(&v, src+i, 8);
+        memcpy(dst+i, &v, 8);
+        c = crc32c_u64(c, v);
+    }
+    for(; i<n; i++){ dst[i] = src[i]; c = crc32c_u8(c, src[i]); }
+    for(; i<bs && (i&7u); i++){ dst[i] = 0; c = crc32c_u8(c, 0); }
+    for(; i<bs; i+=8){ memset(dst+i, 0, 8); c = crc32c_u64(c, 0); }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// ========================== SHA-256 ==========================
+// Plain FIPS 180-4 SHA-256, used for the hash tree.
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+    0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+    0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+    0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+    0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+    0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+    0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+    0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+};
+typedef struct {
+    uint32_t h[8];
+    uint8_t  buf[64];
+    uint64_t len;
+    size_t   n;
+} sha256_t;
+
+#define ROR32(x,r) (((x) >> (r)) | ((x) << (32-(r))))
+static inline void sha256_compress(uint32_t h[8], const uint8_t* p){
+    uint32_t w[64];
+    for(int i=0;i<16;i++) w[i] = (uint32_t)p[4*i]<<24 | (uint32_t)p[4*i+1]<<16 | (uint32_t)p[4*i+2]<<8 | p[4*i+3];
+    for(int i=16;i<64;i++){
+        uint32_t s0 = ROR32(w[i-15],7) ^ ROR32(w[i-15],18) ^ (w[i-15]>>3);
+        uint32_t s1 = ROR32(w[i-2],17) ^ ROR32(w[i-2],19) ^ (w[i-2]>>10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+    uint32_t a=h[0],b=h[1],c=h[2],d=h[3],e=h[4],f=h[5],g=h[6],k=h[7];
+    for(int i=0;i<64;i++){
+        uint32_t t1 = k + (ROR32(e,6) ^ ROR32(e,11) ^ ROR32(e,25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (ROR32(a,2) ^ ROR32(a,13) ^ ROR32(a,22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k=g; g=f; f=e; e=d+t1; d=c; c=b; b=a; a=t1+t2;
+    }
+    h[0]+=a; h[1]+=b; h[2]+=c; h[3]+=d; h[4]+=e; h[5]+=f; h[6]+=g; h[7]+=k;
+}
+static inline void sha256_init(sha256_t* s){
+    static const uint32_t iv[8] = {0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19};
+    memcpy(s->h, iv, sizeof(iv));
+    s->len = 0; s->n = 0;
+}
+static inline void sha256_update(sha256_t* s, const void* data, size_t n){
+    const uint8_t* p = (const uint8_t*)data;
+    s->len += n;
+    if(s->n){
+        size_t k = 64 - s->n < n ? 64 - s->n : n;
+        memcpy(s->buf + s->n, p, k); s->n += k; p += k; n -= k;
+        if(s->n < 64) return;
+        sha256_compress(s->h, s->buf); s->n = 0;
+    }
+    for(; n>=64; p+=64, n-=64) sha256_compress(s->h, p);
+    memcpy(s->buf, p, n); s->n = n;
+}
+static inline void sha256_final(sha256_t* s, uint8_t out[32]){
+    uint64_t bits = s->len * 8;
+    uint8_t pad = 0x80;
+    sha256_update(s, &pad, 1);
+    pad = 0;
+    while(s->n != 56) sha256_update(s, &pad, 1);
+    uint8_t be[8];
+    for(int i=0;i<8;i++) be[i] = (uint8_t)(bits >> (56 - 8*i));
+    sha256_update(s, be, 8);
+    for(int i=0;i<8;i++){
+        out[4*i] = (uint8_t)(s->h[i]>>24); out[4*i+1] = (uint8_t)(s->h[i]>>16);
+        out[4*i+2] = (uint8_t)(s->h[i]>>8); out[4*i+3] = (uint8_t)s->h[i];
+    }
+}
+
+// Tree hashes are domain-separated so a leaf can never pose as a node:
+//     leaf = SHA256(0x00 || block), node = SHA256(0x01 || left || right)
+static inline void merkle_leaf(const uint8_t* blk, uint32_t bs, uint8_t out[32]){
+    sha256_t s; uint8_t tag = 0;
+    sha256_init(&s); sha256_update(&s, &tag, 1); sha256_update(&s, blk, bs); sha256_final(&s, out);
+}
+static inline void merkle_node(const uint8_t* l, const uint8_t* r, uint8_t out[32]){
+    sha256_t s; uint8_t tag = 1;
+    sha256_init(&s); sha256_update(&s, &tag, 1); sha256_update(&s, l, 32); sha256_update(&s, r, 32); sha256_final(&s, out);
+}
+
+// ========================== Utils ==========================
+static inline void die(const char* msg){
+    fprintf(stderr, "Error: %s\n", msg);
+    exit(1);
+}
+static inline int parse_u64(const char* s, uint64_t* out){
+    char* end=NULL;
+    errno=0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if(errno || end==s || *end!='\0') return 0;
+    *out = (uint64_t)v;
+    return 1;
+}
+static inline int test_bit(const uint8_t* bm, uint64_t idx){
+    return (bm[idx>>3] >> (idx & 7u)) & 1u;
+}
+static inline void set_bit(uint8_t* bm, uint64_t idx){
+    bm[idx >> 3] |= (uint8_t)(1u << (idx & 7u));
+}
+static inline void clear_bit(uint8_t* bm, uint64_t idx){
+    bm[idx >> 3] &= (uint8_t)~(1u << (idx & 7u));
+}
+// find first zero bit (return index or -1)
+static inline int64_t find_first_zero_bit(const uint8_t* bm, uint64_t nbits){
+    for(uint64_t i=0;i<nbits;i++){
+        if(!test_bit(bm,i)) return (int64_t)i;
+    }
+    return -1;
+}
+
+#endif
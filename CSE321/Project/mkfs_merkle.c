@@ -0,0 +1,264 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra -pthread mkfs_merkle.c -o mkfs_merkle
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mkfs_format.h"
+
+#define MAX_THREADS 64
+
+// ========================== Utils ==========================
+static int pwrite_full(int fd, const void* buf, size_t n, off_t off){
+    const uint8_t* p = (const uint8_t*)buf;
+    while(n){
+        ssize_t w = pwrite(fd, p, n, off);
+        if(w <= 0){ if(w < 0 && errno == EINTR) continue; return 0; }
+        p += w; n -= (size_t)w; off += w;
+    }
+    return 1;
+}
+static uint64_t leaves_for(uint64_t total_blocks){
+    uint64_t p = 1;
+    while(p < total_blocks - 1) p <<= 1;
+    return p;
+}
+
+// ========================== Parallel tree hash ==========================
+// The leaves are split into T (a power of two) aligned slices; each worker
+// hashes its blocks and then folds its slice up to the slice's subtree root,
+// so only the top log2(T) levels are left for the main thread.
+typedef struct {
+    const uint8_t* img;
+    uint32_t bs;
+    uint64_t nblocks;
+    uint64_t leaves;
+    uint8_t (*tree)[32];
+    uint64_t lo, hi;          // leaf range [lo, hi)
+} hash_job_t;
+
+static void* hash_worker(void* arg){
+    hash_job_t* j = (hash_job_t*)arg;
+    for(uint64_t i=j->lo;i<j->hi;i++){
+        uint64_t b = i + 1;
+        if(b < j->nblocks) merkle_leaf(j->img + b*j->bs, j->bs, j->tree[j->leaves + i]);
+        else memset(j->tree[j->leaves + i], 0, 32);
+    }
+    for(uint64_t lo=(j->leaves+j->lo)>>1, hi=(j->leaves+j->hi)>>1; hi-lo>=1 && lo>=1; lo>>=1, hi>>=1){
+        for(uint64_t n=lo;n<hi;n++) merkle_node(j->tree[2*n], j->tree[2*n+1], j->tree[n]);
+        if(hi - lo == 1) break;
+    }
+    return NULL;
+}
+
+static void hash_tree(const uint8_t* img, uint32_t bs, uint64_t nblocks, uint64_t leaves,
+                      uint8_t (*tree)[32], unsigned threads){
+    unsigned t = 1;
+    while(t*2 <= threads && t*2 <= leaves) t *= 2;
+    pthread_t tid[MAX_THREADS];
+    hash_job_t jobs[MAX_THREADS];
+    uint64_t slice = leaves / t;
+    for(unsigned i=0;i<t;i++){
+        jobs[i] = (hash_job_t){ img, bs, nblocks, leaves, tree, i*slice, (i+1)*slice };
+        if(pthread_create(&tid[i], NULL, hash_worker, &jobs[i]) != 0) die("pthread_create failed");
+    }
+    for(unsigned i=0;i<t;i++) pthread_join(tid[i], NULL);
+    // slice roots are nodes [t, 2t); fold the rest
+    for(uint64_t n=t-1;n>=1;n--) merkle_node(tree[2*n], tree[2*n+1], tree[n]);
+}
+
+// ========================== Damage localization ==========================
+// Walks down from the root into every subtree whose fresh hash differs from
+// the stored one, so k damaged blocks cost O(k log n) comparisons. Along the
+// way each stored node is checked against its stored children; that, plus
+// the root in block 0, authenticates the side file itself.
+typedef struct {
+    uint64_t run_lo, run_hi;  // pending damaged block range
+    uint64_t bad_blocks;
+    uint64_t ranges;
+    uint64_t bad_nodes;
+} damage_t;
+
+static void damage_flush(damage_t* d){
+    if(d->run_hi > d->run_lo){
+        if(d->run_hi - d->run_lo == 1) printf("  block %" PRIu64 " differs\n", d->run_lo);
+        else printf("  blocks %" PRIu64 "-%" PRIu64 " differ\n", d->run_lo, d->run_hi - 1);
+        d->ranges++;
+    }
+    d->run_lo = d->run_hi = 0;
+}
+
+static void descend(uint8_t (*st)[32], uint8_t (*fr)[32], uint64_t leaves, uint64_t nblocks, uint64_t n, damage_t* d){
+    if(!memcmp(st[n], fr[n], 32)) return;
+    if(n >= leaves){
+        uint64_t b = n - leaves + 1;
+        if(b >= nblocks) return;
+        if(d->run_hi != b){ damage_flush(d); d->run_lo = b; }
+        d->run_hi = b + 1;
+        d->bad_blocks++;
+        return;
+    }
+    uint8_t h[32];
+    merkle_node(st[2*n], st[2*n+1], h);
+    if(memcmp(h, st[n], 32)){
+        printf("  hash tree node %" PRIu64 " is inconsistent with its children\n", n);
+        d->bad_nodes++;
+    }
+    descend(st, fr, leaves, nblocks, 2*n, d);
+    descend(st, fr, leaves, nblocks, 2*n+1, d);
+}
+
+// ========================== Main ==========================
+// --build   hashes every block, writes <image>.mkl and records the root in
+//           block 0 (sets MVSF_FLAG_MERKLE)
+// --verify  rehashes in parallel and reports which block ranges differ
+// --block N checks one block against its authentication path only
+int main(int argc, char** argv) {
+    crc32_init();
+
+    const char* image = NULL;
+    int mode = 0;             // 1 build, 2 verify, 3 single block
+    uint64_t threads = 0, one_block = 0;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--image") && i+1<argc) image=argv[++i];
+        else if(!strcmp(argv[i],"--build")) mode = 1;
+        else if(!strcmp(argv[i],"--verify")) mode = 2;
+        else if(!strcmp(argv[i],"--block") && i+1<argc && parse_u64(argv[++i], &one_block)) mode = 3;
+        else if(!strcmp(argv[i],"--threads") && i+1<argc) parse_u64(argv[++i], &threads);
+        else {
+            fprintf(stderr,"Usage: %s --image fs.img (--build | --verify | --block N) [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!image || !mode) die("missing required arguments");
+    if(threads == 0){
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (uint64_t)n : 1;
+    }
+    if(threads > MAX_THREADS) threads = MAX_THREADS;
+
+    int fd = open(image, mode == 1 ? O_RDWR : O_RDONLY);
+    if(fd < 0){ perror("open image"); return 1; }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)BS_MIN){ close(fd); die("image too small"); }
+    uint8_t* img = (uint8_t*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(img == MAP_FAILED){ perror("mmap"); close(fd); return 1; }
+    posix_madvise(img, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    const superblock_t* sb = (const superblock_t*)img;
+    uint32_t bs = sb->block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || sb->magic != 0x4D565346u) die("invalid superblock");
+    uint64_t nblocks = sb->total_blocks;
+    if((uint64_t)st.st_size != nblocks * bs || nblocks < 2) die("image size mismatch");
+
+    uint8_t* blk0 = (uint8_t*)malloc(bs);
+    if(!blk0) die("malloc failed");
+    memcpy(blk0, img, bs);
+    uint32_t stored = ((superblock_t*)blk0)->checksum;
+    if(superblock_crc_finalize((superblock_t*)blk0) != stored) die("superblock checksum mismatch");
+
+    char mkl[4096];
+    snprintf(mkl, sizeof(mkl), "%s.mkl", image);
+    uint64_t leaves = leaves_for(nblocks);
+    size_t tree_bytes = (size_t)(2*leaves*32);
+    uint8_t (*fresh)[32] = NULL;
+
+    if(mode == 1){
+        fresh = (uint8_t (*)[32])calloc(2*leaves, 32);
+        if(!fresh) die("malloc failed");
+        hash_tree(img, bs, nblocks, leaves, fresh, (unsigned)threads);
+
+        merkle_hdr_t hdr = { MERKLE_MAGIC, 1, bs, 0, nblocks, leaves };
+        FILE* fo = fopen(mkl, "wb");
+        if(!fo){ perror("fopen hash tree"); return 1; }
+        if(fwrite(&hdr, sizeof(hdr), 1, fo) != 1 || fwrite(fresh, 1, tree_bytes, fo) != tree_bytes){
+            perror("fwrite"); fclose(fo); return 1;
+        }
+        if(fclose(fo) != 0){ perror("fclose"); return 1; }
+
+        // root into block 0 only once the side file is complete
+        superblock_t* nsb = (superblock_t*)blk0;
+        memcpy(blk0 + MERKLE_ROOT_OFF, fresh[1], 32);
+        nsb->flags |= MVSF_FLAG_MERKLE;
+        superblock_crc_finalize(nsb);
+        if(!pwrite_full(fd, blk0, bs, 0)){ perror("write superblock"); return 1; }
+        if(fsync(fd) != 0) perror("fsync");
+
+        printf("Hash tree: %s (%" PRIu64 " leaves, %zu bytes)\n", mkl, leaves, sizeof(hdr) + tree_bytes);
+        printf("Root: ");
+        for(int i=0;i<32;i++) printf("%02x", fresh[1][i]);
+        printf("\n");
+        free(fresh);
+        free(blk0);
+        munmap(img, (size_t)st.st_size);
+        close(fd);
+        return 0;
+    }
+
+    if(!(sb->flags & MVSF_FLAG_MERKLE)) die("image has no hash tree (run with --build)");
+    const uint8_t* root = img + MERKLE_ROOT_OFF;
+
+    FILE* fm = fopen(mkl, "rb");
+    if(!fm){ perror(mkl); return 1; }
+    merkle_hdr_t hdr;
+    uint8_t (*stree)[32] = (uint8_t (*)[32])malloc(tree_bytes);
+    if(!stree) die("malloc failed");
+    if(fread(&hdr, sizeof(hdr), 1, fm) != 1 || hdr.magic != MERKLE_MAGIC || hdr.version != 1 ||
+       hdr.block_size != bs || hdr.total_blocks != nblocks || hdr.leaves != leaves ||
+       fread(stree, 1, tree_bytes, fm) != tree_bytes){
+        fclose(fm); die("hash tree file does not match the image");
+    }
+    fclose(fm);
+    if(memcmp(stree[1], root, 32)) die("hash tree root does not match the superblock");
+
+    if(mode == 3){
+        if(one_block == 0 || one_block >= nblocks) die("block out of range (1..total_blocks-1)");
+        uint64_t n = leaves + one_block - 1;
+        uint8_t h[32];
+        merkle_leaf(img + one_block*bs, bs, h);
+        int ok = !memcmp(h, stree[n], 32);
+        // climb with the stored siblings; the result must land on the root
+        for(; n>1 && ok; n>>=1){
+            if(n & 1) merkle_node(stree[n-1], h, h);
+            else      merkle_node(h, stree[n+1], h);
+        }
+        ok = ok && !memcmp(h, root, 32);
+        printf("Block %" PRIu64 ": %s\n", one_block, ok ? "OK" : "MISMATCH");
+        return ok ? 0 : 1;
+    }
+
+    fresh = (uint8_t (*)[32])calloc(2*leaves, 32);
+    if(!fresh) die("malloc failed");
+    hash_tree(img, bs, nblocks, leaves, fresh, (unsigned)threads);
+
+    damage_t d = {0};
+    if(memcmp(fresh[1], root, 32)){
+        printf("Root mismatch, localizing:\n");
+        descend(stree, fresh, leaves, nblocks, 1, &d);
+        damage_flush(&d);
+    }
+    printf("Blocks hashed: %" PRIu64 " with %" PRIu64 " thread(s)\n", nblocks - 1, threads);
+    if(d.bad_blocks || d.bad_nodes || memcmp(fresh[1], root, 32))
+        printf("DAMAGED: %" PRIu64 " block(s) in %" PRIu64 " range(s), %" PRIu64 " bad tree node(s)\n",
+               d.bad_blocks, d.ranges, d.bad_nodes);
+    else
+        printf("OK\n");
+
+    int bad = memcmp(fresh[1], root, 32) != 0;
+    free(fresh);
+    free(stree);
+    free(blk0);
+    munmap(img, (size_t)st.st_size);
+    close(fd);
+    return bad;
+}
@@ -0,0 +1,180 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_patch.c -o mkfs_patch
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mkfs_format.h"
+
+#define PATCH_MAGIC 0x5044564Du   // "MVDP"
+
+#pragma pack(push,1)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t base_meta_crc;
+    uint32_t target_meta_crc;
+    uint32_t payload_crc;     // crc32 of everything after the header
+    uint64_t base_blocks;
+    uint64_t target_blocks;
+    uint64_t extent_count;
+} patch_hdr_t;
+
+typedef struct {
+    uint64_t start;
+    uint32_t count;
+} patch_extent_t;
+#pragma pack(pop)
+_Static_assert(sizeof(patch_hdr_t) == 48, "patch header size mismatch");
+_Static_assert(sizeof(patch_extent_t) == 12, "patch extent size mismatch");
+
+// ========================== Utils ==========================
+static int pread_full(int fd, void* buf, size_t n, off_t off){
+    uint8_t* p = (uint8_t*)buf;
+    while(n){
+        ssize_t r = pread(fd, p, n, off);
+        if(r <= 0){ if(r < 0 && errno == EINTR) continue; return 0; }
+        p += r; n -= (size_t)r; off += r;
+    }
+    return 1;
+}
+static int pwrite_full(int fd, const void* buf, size_t n, off_t off){
+    const uint8_t* p = (const uint8_t*)buf;
+    while(n){
+        ssize_t w = pwrite(fd, p, n, off);
+        if(w <= 0){ if(w < 0 && errno == EINTR) continue; return 0; }
+        p += w; n -= (size_t)w; off += w;
+    }
+    return 1;
+}
+
+// crc32 over blocks [0, data_region_start), matching mkfs_diff's header
+static uint32_t meta_crc(int fd, const superblock_t* sb){
+    size_t n = (size_t)(sb->data_region_start * sb->block_size);
+    uint8_t* meta = (uint8_t*)malloc(n);
+    if(!meta) die("malloc failed");
+    if(!pread_full(fd, meta, n, 0)) die("read metadata failed");
+    uint32_t c = crc32(meta, n);
+    free(meta);
+    return c;
+}
+
+// Reads the whole patch once before anything is written: every extent must
+// lie inside the target, the payload must end exactly at end of file and
+// its crc32 must match the header. Leaves fp just past the header.
+static int check_patch(FILE* fp, const patch_hdr_t* hdr, uint8_t* buf){
+    uint32_t bs = hdr->block_size, crc = 0;
+    for(uint64_t e=0;e<hdr->extent_count;e++){
+        patch_extent_t ext;
+        if(fread(&ext, sizeof(ext), 1, fp) != 1) return 0;
+        if(ext.start > hdr->target_blocks || ext.count > hdr->target_blocks - ext.start) return 0;
+        crc = crc32_update(crc, &ext, sizeof(ext));
+        for(uint32_t i=0;i<ext.count;i++){
+            if(fread(buf, bs, 1, fp) != 1) return 0;
+            crc = crc32_update(crc, buf, bs);
+        }
+    }
+    if(fgetc(fp) != EOF || crc != hdr->payload_crc) return 0;
+    return fseeko(fp, (off_t)sizeof(*hdr), SEEK_SET) == 0;
+}
+
+// ========================== Main ==========================
+// Applies a mkfs_diff patch to the base image in place. The base is
+// identified by a CRC over its metadata blocks (superblock, bitmaps, inode
+// table), so a patch is never applied on top of the wrong version, and the
+// patch itself is checked end to end before the first write. Block 0 is
+// held back and written only after every other block has landed.
+int main(int argc, char** argv) {
+    crc32_init();
+
+    const char* image = NULL;
+    const char* patch = NULL;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--image") && i+1<argc) image=argv[++i];
+        else if(!strcmp(argv[i],"--patch") && i+1<argc) patch=argv[++i];
+        else {
+            fprintf(stderr,"Usage: %s --image base.img --patch delta.patch\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!image || !patch) die("missing required arguments");
+
+    FILE* fp = fopen(patch, "rb");
+    if(!fp){ perror("fopen patch"); return 1; }
+    patch_hdr_t hdr;
+    if(fread(&hdr, sizeof(hdr), 1, fp) != 1){ fclose(fp); die("read patch header failed"); }
+    uint32_t bs = hdr.block_size;
+    if(hdr.magic != PATCH_MAGIC || hdr.version != 2 || bs < BS_MIN || bs > BS_MAX || (bs & (bs-1))){
+        fclose(fp); die("not a MiniVSFS patch");
+    }
+
+    int fd = open(image, O_RDWR);
+    if(fd < 0){ perror("open image"); fclose(fp); return 1; }
+    struct stat st;
+    superblock_t sb;
+    if(fstat(fd, &st) != 0 || !pread_full(fd, &sb, sizeof(sb), 0)){
+        close(fd); fclose(fp); die("read superblock failed");
+    }
+    if(sb.magic != 0x4D565346u || sb.block_size != bs || (uint64_t)st.st_size != hdr.base_blocks * bs || meta_crc(fd, &sb) != hdr.base_meta_crc){
+        close(fd); fclose(fp); die("patch does not apply to this image");
+    }
+
+    uint8_t* buf = (uint8_t*)malloc(bs);
+    uint8_t* blk0 = (uint8_t*)malloc(bs);
+    if(!buf || !blk0){ close(fd); fclose(fp); die("malloc failed"); }
+    int have_blk0 = 0;
+    if(!check_patch(fp, &hdr, buf)){ close(fd); fclose(fp); die("patch is truncated or corrupt"); }
+
+    if(hdr.target_blocks > hdr.base_blocks && ftruncate(fd, (off_t)(hdr.target_blocks * bs)) != 0){
+        perror("ftruncate"); close(fd); fclose(fp); return 1;
+    }
+
+    uint64_t blocks = 0;
+    for(uint64_t e=0;e<hdr.extent_count;e++){
+        patch_extent_t ext;
+        if(fread(&ext, sizeof(ext), 1, fp) != 1){ close(fd); fclose(fp); die("patch changed while applying"); }
+        for(uint64_t b=ext.start;b<ext.start+ext.count;b++){
+            if(fread(buf, bs, 1, fp) != 1){ close(fd); fclose(fp); die("patch changed while applying"); }
+            if(b == 0){ memcpy(blk0, buf, bs); have_blk0 = 1; continue; }
+            if(!pwrite_full(fd, buf, bs, (off_t)(b * bs))){
+                perror("pwrite"); close(fd); fclose(fp); return 1;
+            }
+            blocks++;
+        }
+    }
+    fclose(fp);
+
+    // Superblock last, once everything else is on disk. This narrows the
+    // window but is not atomic: the bitmaps and inode table were rewritten
+    // above, so a run interrupted here leaves an image that matches neither
+    // version (and no longer takes this patch). Keep a copy of the base if
+    // that matters.
+    if(fsync(fd) != 0) perror("fsync");
+    if(have_blk0){
+        if(!pwrite_full(fd, blk0, bs, 0)){ perror("pwrite superblock"); close(fd); return 1; }
+        blocks++;
+    }
+    if(hdr.target_blocks < hdr.base_blocks && ftruncate(fd, (off_t)(hdr.target_blocks * bs)) != 0){
+        perror("ftruncate"); close(fd); return 1;
+    }
+    if(fsync(fd) != 0) perror("fsync");
+    if(!pread_full(fd, &sb, sizeof(sb), 0) || meta_crc(fd, &sb) != hdr.target_meta_crc){
+        close(fd); die("patched metadata does not match the target");
+    }
+    close(fd);
+    free(buf);
+    free(blk0);
+
+    printf("Patched image: %s\n", image);
+    printf("Blocks written: %" PRIu64 ", size: %" PRIu64 " blocks\n", blocks, hdr.target_blocks);
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Reading a file out of an in-memory (or mapped) image: root directory
+// lookup, tail fragments and lazy CRC32C verification. Shared by mkfs_cat
+// and mkfs_replay so the replay times the read path cat actually runs.
+//
+// The caller runs crc32c_init() first. The image must hold every block up
+// to data_region_start + data_region_blocks.
+#ifndef MKFS_READ_H
+#define MKFS_READ_H
+
+#include "mkfs_format.h"
+
+enum { READ_OK = 0, READ_NOT_FOUND, READ_BAD_CSUM, READ_CORRUPT, READ_OUTPUT, READ_RESULTS };
+static const char* const READ_RESULT_NAME[READ_RESULTS] = {
+    "ok", "file not found", "checksum error", "corrupt inode", "output error"
+};
+
+// receives the file contents in order; returns 0 to stop the read
+typedef int (*read_sink_t)(void* ctx, const uint8_t* p, size_t n);
+
+// inode number of the regular file called name in the root; 0 if absent
+static uint32_t lookup_file(const uint8_t* img, const char* name){
+    const superblock_t* sb = (const superblock_t*)img;
+    uint32_t bs = sb->block_size;
+    uint64_t drs = sb->data_region_start, drb = sb->data_region_blocks;
+    const inode_t* root = (const inode_t*)(img + sb->inode_table_start*bs);
+    for(int k=0;k<DIRECT_MAX;k++){
+        if(root->direct[k] < drs || root->direct[k] >= drs + drb) continue;
+        const dirent64_t* ents = (const dirent64_t*)(img + (uint64_t)root->direct[k]*bs);
+        for(uint32_t e=0;e<bs/sizeof(dirent64_t);e++){
+            if(ents[e].inode_no && ents[e].type == 1 && strncmp(ents[e].name, name, sizeof(ents[e].name)) == 0)
+                return ents[e].inode_no <= sb->inode_count ? ents[e].inode_no : 0;
+        }
+    }
+    return 0;
+}
+
+// Streams file name to sink: whole blocks first, then the packed tail. Only
+// the blocks touched are read; with verify set and a checksum region in the
+// image each is checked against its CRC32C first, and *bad gets the block
+// that failed. *size gets the file size once the inode is found.
+static int read_file(const uint8_t* img, const char* name, int verify, read_sink_t sink, void* ctx,
+                     uint64_t* size, uint32_t* bad){
+    const superblock_t* sb = (const superblock_t*)img;
+    uint32_t bs = sb->block_size;
+    uint64_t drs = sb->data_region_start, drb = sb->data_region_blocks;
+    const uint32_t* csum = (verify && (sb->flags & MVSF_FLAG_DATA_CSUM))
+        ? (const uint32_t*)(img + (sb->inode_table_start + sb->inode_table_blocks)*bs) : NULL;
+
+    uint32_t ino = lookup_file(img, name);
+    if(!ino) return READ_NOT_FOUND;
+    const inode_t* node = (const inode_t*)(img + sb->inode_table_start*bs + (uint64_t)(ino-1)*INODE_SIZE);
+    *size = node->size_bytes;
+
+    // a packed tail (reserved_0 = fragment block) is read after the whole blocks
+    uint64_t tail = node->reserved_0 ? node->reserved_2 : 0;
+    if(tail > node->size_bytes || (tail && (uint64_t)node->reserved_1 + tail > bs)) return READ_CORRUPT;
+    uint64_t left = node->size_bytes - tail;
+    for(int k=0;k<DIRECT_MAX && left;k++){
+        uint32_t b = node->direct[k];
+        if(b < drs || b >= drs + drb) return READ_CORRUPT;
+        const uint8_t* blk = img + (uint64_t)b*bs;
+        if(csum && crc32c_block(blk, bs) != csum[b - drs]){ *bad = b; return READ_BAD_CSUM; }
+        size_t chunk = left > bs ? bs : (size_t)left;
+        if(!sink(ctx, blk, chunk)) return READ_OUTPUT;
+        left -= chunk;
+    }
+    if(left) return READ_CORRUPT;
+    if(tail){
+        uint32_t b = node->reserved_0;
+        if(b < drs || b >= drs + drb) return READ_CORRUPT;
+        const uint8_t* blk = img + (uint64_t)b*bs;
+        if(csum && crc32c_block(blk, bs) != csum[b - drs]){ *bad = b; return READ_BAD_CSUM; }
+        if(!sink(ctx, blk + node->reserved_1, (size_t)tail)) return READ_OUTPUT;
+    }
+    return READ_OK;
+}
+
+#endif
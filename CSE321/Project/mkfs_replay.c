@@ -0,0 +1,234 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_replay.c -o mkfs_replay
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+
+#include "mkfs_format.h"
+
+// ========================== Utils ==========================
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ========================== Operations ==========================
+// ADD and READ run the same code as mkfs_adder and mkfs_cat, minus the file
+// I/O around them, so the replay times only allocator, directory and
+// checksum work. A failed add leaves the image exactly as it was.
+#include "mkfs_add.h"
+#include "mkfs_read.h"
+
+// READ copies the file into a scratch buffer, one chunk at a time
+static int sink_copy(void* ctx, const uint8_t* p, size_t n){
+    memcpy(ctx, p, n);
+    return 1;
+}
+
+// ========================== Statistics ==========================
+typedef struct {
+    uint64_t* ns;
+    uint64_t n, cap;
+    uint64_t results[8];      // by ADD_* or READ_* code
+} op_stats_t;
+_Static_assert(ADD_RESULTS <= 8 && READ_RESULTS <= 8, "op_stats_t.results too small");
+
+static void stats_push(op_stats_t* s, uint64_t ns){
+    if(s->n == s->cap){
+        s->cap = s->cap ? s->cap*2 : 1024;
+        s->ns = (uint64_t*)realloc(s->ns, s->cap * sizeof(uint64_t));
+        if(!s->ns) die("malloc failed");
+    }
+    s->ns[s->n++] = ns;
+}
+static int u64_cmp(const void* a, const void* b){
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+// nearest-rank percentile of a sorted sample
+static uint64_t pct(const uint64_t* v, uint64_t n, double p){
+    uint64_t r = (uint64_t)(p * (double)n + 0.999999);
+    if(r < 1) r = 1;
+    if(r > n) r = n;
+    return v[r-1];
+}
+
+// ========================== Main ==========================
+// Replays a trace against a copy of --image held in memory, timing each
+// operation with CLOCK_MONOTONIC. A FORMAT record resets the working copy
+// to the pristine image; file contents for ADD are synthetic bytes of the
+// recorded size. Usage:
+//     ./mkfs_replay --trace ops.trace --image fs.img [--repeat N] [--output final.img]
+int main(int argc, char** argv) {
+    crc32_init();
+    crc32c_init();
+
+    const char* trace = NULL;
+    const char* image = NULL;
+    const char* output = NULL;
+    uint64_t repeat = 1;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--trace") && i+1<argc) trace=argv[++i];
+        else if(!strcmp(argv[i],"--image") && i+1<argc) image=argv[++i];
+        else if(!strcmp(argv[i],"--output") && i+1<argc) output=argv[++i];
+        else if(!strcmp(argv[i],"--repeat") && i+1<argc) parse_u64(argv[++i], &repeat);
+        else {
+            fprintf(stderr,"Usage: %s --trace ops.trace --image fs.img [--repeat N] [--output final.img]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!trace || !image || !repeat) die("missing required arguments");
+
+    // -------- load the trace --------
+    FILE* ft = fopen(trace, "rb");
+    if(!ft){ perror("fopen trace"); return 1; }
+    fseeko(ft, 0, SEEK_END);
+    off_t tsz = ftello(ft);
+    fseeko(ft, 0, SEEK_SET);
+    if(tsz < (off_t)sizeof(trace_hdr_t)){ fclose(ft); die("trace too small"); }
+    uint8_t* tbuf = (uint8_t*)malloc((size_t)tsz);
+    if(!tbuf){ fclose(ft); die("malloc failed"); }
+    if(fread(tbuf, 1, (size_t)tsz, ft) != (size_t)tsz){ fclose(ft); die("read trace failed"); }
+    fclose(ft);
+    trace_hdr_t th;
+    memcpy(&th, tbuf, sizeof(th));
+    if(th.magic != TRACE_MAGIC || th.version != 1) die("not a MiniVSFS trace");
+
+    // index records and size the synthetic file buffer
+    uint64_t nrec = 0, max_size = 0;
+    for(size_t off=sizeof(th); off<(size_t)tsz; ){
+        if(off + sizeof(trace_rec_t) > (size_t)tsz) die("truncated trace");
+        trace_rec_t r;
+        memcpy(&r, tbuf + off, sizeof(r));
+        if(r.op < TRACE_FORMAT || r.op >= TRACE_OPS) die("bad trace record");
+        off += sizeof(r) + r.name_len;
+        if(off > (size_t)tsz) die("truncated trace");
+        // no file is larger than its direct blocks plus a packed tail of at
+        // most half a block; anything bigger is a damaged record
+        if(r.op != TRACE_FORMAT && (r.block_size < BS_MIN || r.block_size > BS_MAX ||
+                                    r.arg0 > (uint64_t)DIRECT_MAX * r.block_size + r.block_size/2))
+            die("bad trace record");
+        if(r.op == TRACE_ADD && r.arg0 > max_size) max_size = r.arg0;
+        nrec++;
+    }
+    const uint8_t** recs = (const uint8_t**)malloc((nrec ? nrec : 1) * sizeof(uint8_t*));
+    if(!recs) die("malloc failed");
+    nrec = 0;
+    for(size_t off=sizeof(th); off<(size_t)tsz; ){
+        recs[nrec++] = tbuf + off;
+        off += sizeof(trace_rec_t) + ((const trace_rec_t*)(tbuf + off))->name_len;
+    }
+
+    // -------- load the image --------
+    FILE* fi = fopen(image, "rb");
+    if(!fi){ perror("fopen image"); return 1; }
+    fseeko(fi, 0, SEEK_END);
+    off_t fsz = ftello(fi);
+    fseeko(fi, 0, SEEK_SET);
+    if(fsz < (off_t)BS_MIN){ fclose(fi); die("image too small"); }
+    uint8_t* base = (uint8_t*)malloc((size_t)fsz);
+    uint8_t* img = (uint8_t*)malloc((size_t)fsz);
+    if(!base || !img){ fclose(fi); die("malloc failed"); }
+    if(fread(base, 1, (size_t)fsz, fi) != (size_t)fsz){ fclose(fi); die("read image failed"); }
+    fclose(fi);
+    const superblock_t* sb = (const superblock_t*)base;
+    uint32_t bs = sb->block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || sb->magic != 0x4D565346u) die("invalid superblock");
+    if((uint64_t)fsz != sb->total_blocks * bs) die("image size mismatch");
+    if(sb->flags & MVSF_FLAG_MERKLE)
+        fprintf(stderr, "Warning: hash tree is not maintained during replay\n");
+
+    size_t fbuf_len = (size_t)(max_size + bs);
+    uint8_t* fbuf = (uint8_t*)malloc(fbuf_len);
+    uint8_t* sink = (uint8_t*)malloc((size_t)DIRECT_MAX * bs + bs);
+    if(!fbuf || !sink) die("malloc failed");
+    uint32_t x = 0x9E3779B9u;
+    for(size_t i=0;i<fbuf_len;i++){ x ^= x << 13; x ^= x >> 17; x ^= x << 5; fbuf[i] = (uint8_t)x; }
+
+    // -------- replay --------
+    static const char* OP_NAME[TRACE_OPS] = { "", "format", "add", "read" };
+    op_stats_t st[TRACE_OPS];
+    memset(st, 0, sizeof(st));
+    int warned = 0;
+    char name[256];
+    uint64_t t_start = now_ns();
+    for(uint64_t pass=0; pass<repeat; pass++){
+        memcpy(img, base, (size_t)fsz);
+        for(uint64_t i=0;i<nrec;i++){
+            trace_rec_t r;
+            memcpy(&r, recs[i], sizeof(r));
+            memcpy(name, recs[i] + sizeof(r), r.name_len);
+            name[r.name_len] = '\0';
+
+            int rc = ADD_OK;
+            uint32_t ino;
+            uint64_t size;
+            uint64_t t0 = now_ns();
+            switch(r.op){
+            case TRACE_FORMAT:
+                memcpy(img, base, (size_t)fsz);
+                break;
+            case TRACE_ADD:
+                rc = add_file(img, fbuf, r.arg0, name, NULL, &ino);
+                break;
+            case TRACE_READ:
+                rc = read_file(img, name, 1, sink_copy, sink, &size, &ino);
+                break;
+            }
+            uint64_t t1 = now_ns();
+            stats_push(&st[r.op], t1 - t0);
+            st[r.op].results[rc]++;
+
+            if(r.op == TRACE_FORMAT && !warned &&
+               (r.block_size != bs || r.arg0 * 1024u / bs != sb->total_blocks ||
+                (uint32_t)(r.arg1 >> 32) != (sb->flags & ~MVSF_FLAG_MERKLE) || (uint32_t)r.arg1 != sb->inode_count)){
+                fprintf(stderr, "Warning: trace was recorded on a differently formatted image\n");
+                warned = 1;
+            }
+        }
+    }
+    uint64_t t_total = now_ns() - t_start;
+
+    // -------- report --------
+    printf("Trace: %s (%" PRIu64 " ops x %" PRIu64 " pass(es))\n", trace, nrec, repeat);
+    printf("%-7s %9s %10s %10s %10s %10s %10s\n", "op", "count", "p50 us", "p99 us", "p999 us", "max us", "mean us");
+    for(int op=TRACE_FORMAT; op<TRACE_OPS; op++){
+        op_stats_t* s = &st[op];
+        if(!s->n) continue;
+        qsort(s->ns, s->n, sizeof(uint64_t), u64_cmp);
+        uint64_t sum = 0;
+        for(uint64_t i=0;i<s->n;i++) sum += s->ns[i];
+        printf("%-7s %9" PRIu64 " %10.2f %10.2f %10.2f %10.2f %10.2f\n", OP_NAME[op], s->n,
+               pct(s->ns, s->n, 0.50)/1e3, pct(s->ns, s->n, 0.99)/1e3, pct(s->ns, s->n, 0.999)/1e3,
+               s->ns[s->n-1]/1e3, (double)sum/(double)s->n/1e3);
+        int nres = op == TRACE_ADD ? ADD_RESULTS : READ_RESULTS;
+        for(int rc=1; rc<nres; rc++)
+            if(s->results[rc]) printf("        %" PRIu64 " failed: %s\n", s->results[rc],
+                                      op == TRACE_ADD ? ADD_RESULT_NAME[rc] : READ_RESULT_NAME[rc]);
+    }
+    printf("Total: %.3f ms, %.0f ops/s\n", t_total/1e6, (double)(nrec*repeat) / ((double)t_total/1e9));
+
+    if(output){
+        FILE* fo = fopen(output, "wb");
+        if(!fo){ perror("fopen output"); return 1; }
+        if(fwrite(img, 1, (size_t)fsz, fo) != (size_t)fsz){ perror("fwrite"); fclose(fo); return 1; }
+        fclose(fo);
+        printf("Final image: %s\n", output);
+    }
+
+    for(int op=0; op<TRACE_OPS; op++) free(st[op].ns);
+    free(recs);
+    free(tbuf);
+    free(base);
+    free(img);
+    free(fbuf);
+    free(sink);
+    return 0;
+}
@@ -0,0 +1,183 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_resize.c -o mkfs_resize
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mkfs_format.h"
+
+// ========================== Utils ==========================
+static int pread_full(int fd, void* buf, size_t n, off_t off){
+    uint8_t* p = (uint8_t*)buf;
+    while(n){
+        ssize_t r = pread(fd, p, n, off);
+        if(r <= 0){ if(r < 0 && errno == EINTR) continue; return 0; }
+        p += r; n -= (size_t)r; off += r;
+    }
+    return 1;
+}
+static int pwrite_full(int fd, const void* buf, size_t n, off_t off){
+    const uint8_t* p = (const uint8_t*)buf;
+    while(n){
+        ssize_t w = pwrite(fd, p, n, off);
+        if(w <= 0){ if(w < 0 && errno == EINTR) continue; return 0; }
+        p += w; n -= (size_t)w; off += w;
+    }
+    return 1;
+}
+
+// ========================== Main ==========================
+// Resizes an image in place. Only the superblock and the data bitmap are
+// rewritten; file data never moves, so the cost is independent of how much
+// is stored. The data region always ends up as [data_region_start,
+// data_region_start + data_region_blocks). When the existing data bitmap is
+// too small to cover the new region, a larger one is placed in the blocks
+// right after the data region and data_bitmap_start is pointed at it.
+int main(int argc, char** argv) {
+    crc32_init();
+
+    const char* image = NULL;
+    uint64_t size_kib = 0;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--image") && i+1<argc) image=argv[++i];
+        else if(!strcmp(argv[i],"--size-kib") && i+1<argc) parse_u64(argv[++i], &size_kib);
+        else {
+            fprintf(stderr,"Usage: %s --image fs.img --size-kib <new size>\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!image || !size_kib) die("missing required arguments");
+
+    int fd = open(image, O_RDWR);
+    if(fd < 0){ perror("open image"); return 1; }
+
+    superblock_t probe;
+    if(!pread_full(fd, &probe, sizeof(probe), 0)){ close(fd); die("read superblock failed"); }
+    uint32_t bs = probe.block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || probe.magic != 0x4D565346u){
+        close(fd); die("invalid superblock");
+    }
+    if((size_kib % (bs/1024u)) != 0){ close(fd); die("size-kib must be a multiple of the block size"); }
+
+    uint8_t* blk0 = (uint8_t*)malloc(bs);
+    if(!blk0){ close(fd); die("malloc failed"); }
+    if(!pread_full(fd, blk0, bs, 0)){ close(fd); free(blk0); die("read superblock failed"); }
+    superblock_t* sb = (superblock_t*)blk0;
+    uint32_t stored = sb->checksum;
+    if(superblock_crc_finalize(sb) != stored){ close(fd); free(blk0); die("superblock checksum mismatch"); }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (uint64_t)st.st_size != sb->total_blocks * bs){
+        close(fd); free(blk0); die("image size mismatch");
+    }
+
+    uint64_t drs = sb->data_region_start;
+    uint64_t drb = sb->data_region_blocks;
+    uint64_t dbs = sb->data_bitmap_start;
+    uint64_t dbb = sb->data_bitmap_blocks;
+    uint64_t new_total = size_kib * 1024ull / bs;
+    if(new_total <= drs) { close(fd); free(blk0); die("new size leaves no room for a data region"); }
+    if(new_total > UINT32_MAX) { close(fd); free(blk0); die("new size exceeds 32-bit block addressing"); }
+
+    // -------- decide where the data bitmap lives --------
+    // It may stay put if it sits in the front matter and still covers the
+    // whole region; otherwise it moves to the tail, sized for what remains.
+    uint64_t new_dbs = dbs, new_dbb = dbb;
+    uint64_t new_drb = new_total - drs;
+    if(dbs >= drs || dbb * bs * 8ull < new_drb){
+        new_dbb = 1;
+        while(new_dbb * bs * 8ull < new_total - drs - new_dbb) new_dbb++;
+        if(new_total <= drs + new_dbb){ close(fd); free(blk0); die("new size too small"); }
+        new_drb = new_total - drs - new_dbb;
+        new_dbs = drs + new_drb;
+    }
+
+    // the data checksum region is fixed in size; it bounds how far we can grow
+    if(sb->flags & MVSF_FLAG_DATA_CSUM){
+        uint64_t cap = (drs - sb->inode_table_start - sb->inode_table_blocks) * (bs/4);
+        if(new_drb > cap){ close(fd); free(blk0); die("data checksum region too small for the new size"); }
+    }
+
+    // -------- load and validate the current bitmap --------
+    uint8_t* old_bm = (uint8_t*)malloc(dbb * bs);
+    uint8_t* new_bm = (uint8_t*)calloc(new_dbb, bs);
+    if(!old_bm || !new_bm){ close(fd); free(blk0); free(old_bm); free(new_bm); die("malloc failed"); }
+    if(!pread_full(fd, old_bm, dbb * bs, (off_t)(dbs * bs))){
+        close(fd); free(blk0); free(old_bm); free(new_bm); die("read data bitmap failed");
+    }
+    for(uint64_t i=new_drb;i<drb;i++){
+        if(test_bit(old_bm, i)){
+            close(fd); free(blk0); free(old_bm); free(new_bm);
+            die("cannot shrink: data blocks in use beyond the new end (run mkfs_compact first)");
+        }
+    }
+    uint64_t keep_bits = drb < new_drb ? drb : new_drb;
+    memcpy(new_bm, old_bm, (size_t)(keep_bits >> 3));
+    for(uint64_t i=keep_bits & ~7ull;i<keep_bits;i++)
+        if(test_bit(old_bm, i)) new_bm[i>>3] |= (uint8_t)(1u << (i & 7u));
+
+    // -------- grow the file first, so the new bitmap/tail blocks exist --------
+    if(new_total > sb->total_blocks && ftruncate(fd, (off_t)(new_total * bs)) != 0){
+        perror("ftruncate"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+    }
+    if(!pwrite_full(fd, new_bm, new_dbb * bs, (off_t)(new_dbs * bs))){
+        perror("write data bitmap"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+    }
+    // the new bitmap must be durable before the superblock points at it
+    if(fsync(fd) != 0){
+        perror("fsync"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+    }
+
+    uint64_t old_total = sb->total_blocks;
+    sb->total_blocks = new_total;
+    sb->data_region_blocks = new_drb;
+    sb->data_bitmap_start = new_dbs;
+    sb->data_bitmap_blocks = new_dbb;
+    sb->mtime_epoch = (uint64_t)time(NULL);
+    // the leaf count follows total_blocks, so a hash tree has to be rebuilt
+    int had_tree = (sb->flags & MVSF_FLAG_MERKLE) != 0;
+    sb->flags &= ~MVSF_FLAG_MERKLE;
+    memset(blk0 + MERKLE_ROOT_OFF, 0, 32);
+    superblock_crc_finalize(sb);
+    if(!pwrite_full(fd, blk0, bs, 0)){
+        perror("write superblock"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+    }
+    if(fsync(fd) != 0){
+        perror("fsync"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+    }
+    if(new_dbs != dbs && dbs < drs){
+        // old front-matter bitmap is dead now that the superblock is on disk;
+        // leave it zeroed rather than stale
+        memset(old_bm, 0, dbb * bs);
+        if(!pwrite_full(fd, old_bm, dbb * bs, (off_t)(dbs * bs))){
+            perror("clear old data bitmap"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+        }
+    }
+
+    if(new_total < old_total && ftruncate(fd, (off_t)(new_total * bs)) != 0){
+        perror("ftruncate"); close(fd); free(blk0); free(old_bm); free(new_bm); return 1;
+    }
+    if(fsync(fd) != 0) perror("fsync");
+    close(fd);
+
+    printf("Resized MiniVSFS image: %s\n", image);
+    printf("Blocks: %" PRIu64 " -> %" PRIu64 ", data region: %" PRIu64 " -> %" PRIu64 " blocks\n",
+           old_total, new_total, drb, new_drb);
+    if(new_dbs != dbs)
+        printf("Data bitmap moved to block %" PRIu64 " (%" PRIu64 " blocks)\n", new_dbs, new_dbb);
+    if(had_tree) printf("Hash tree dropped (rerun mkfs_merkle --build)\n");
+
+    free(blk0);
+    free(old_bm);
+    free(new_bm);
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_verify.c -o mkfs_verify
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mkfs_format.h"
+
+// ========================== Utils ==========================
+
+typedef struct {
+    uint32_t block, off, len;
+    uint64_t ino;
+} tail_ref_t;
+
+static int tail_cmp(const void* a, const void* b){
+    const tail_ref_t* x = (const tail_ref_t*)a;
+    const tail_ref_t* y = (const tail_ref_t*)b;
+    if(x->block != y->block) return x->block < y->block ? -1 : 1;
+    return (x->off > y->off) - (x->off < y->off);
+}
+
+static uint64_t errors = 0;
+static void report(const char* fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "  ");
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+    errors++;
+}
+
+// ========================== Data blocks (per block size) ==========================
+// Force-inlined once per supported block size so the CRC loop has a constant
+// trip count and (drs + i)*bs is a shift.
+#define BS_CASES(X) X(1024u) X(2048u) X(4096u) X(8192u) X(16384u) X(32768u) X(65536u)
+
+static inline __attribute__((always_inline))
+uint64_t check_data_blocks_bs(const uint32_t bs, const uint8_t* img, const uint8_t* dbm,
+                              const uint32_t* csum, uint64_t drs, uint64_t drb){
+    uint64_t checked = 0;
+    for(uint64_t i=0;i<drb;i++){
+        if(!test_bit(dbm, i)) continue;
+        checked++;
+        if(crc32c_block(img + (drs + i)*bs, bs) != csum[i])
+            report("data block %" PRIu64 ": checksum mismatch (stored %08" PRIx32 ")", drs + i, csum[i]);
+    }
+    return checked;
+}
+
+static uint64_t check_data_blocks(uint32_t bs, const uint8_t* img, const uint8_t* dbm,
+                                  const uint32_t* csum, uint64_t drs, uint64_t drb){
+    switch(bs){
+#define CHECK_CASE(N) case N: return check_data_blocks_bs(N, img, dbm, csum, drs, drb);
+    BS_CASES(CHECK_CASE)
+#undef CHECK_CASE
+    }
+    die("unsupported block size");
+    return 0;
+}
+
+// ========================== Main ==========================
+// Full consistency check of an image: superblock CRC, every allocated
+// inode's CRC and block pointers, root dirent checksums, and (when the image
+// carries a data checksum region) the CRC32C of every allocated data block.
+int main(int argc, char** argv) {
+    crc32_init();
+    crc32c_init();
+
+    const char* image = NULL;
+    int check_data = 1;
+
+    for (int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--image") && i+1<argc) image=argv[++i];
+        else if(!strcmp(argv[i],"--no-data")) check_data=0;
+        else {
+            fprintf(stderr,"Usage: %s --image fs.img [--no-data]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!image) die("missing required arguments");
+
+    int fd = open(image, O_RDONLY);
+    if(fd < 0){ perror("open image"); return 1; }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)BS_MIN){ close(fd); die("image too small"); }
+    uint8_t* img = (uint8_t*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(img == MAP_FAILED){ perror("mmap"); return 1; }
+
+    // -------- superblock --------
+    superblock_t sb;
+    memcpy(&sb, img, sizeof(sb));
+    uint32_t bs = sb.block_size;
+    if(bs < BS_MIN || bs > BS_MAX || (bs & (bs-1)) || sb.magic != 0x4D565346u) die("invalid superblock");
+    if((uint64_t)st.st_size != sb.total_blocks * bs) die("image size mismatch");
+    {
+        uint8_t* blk0 = (uint8_t*)malloc(bs);
+        if(!blk0) die("malloc failed");
+        memcpy(blk0, img, bs);
+        if(superblock_crc_finalize((superblock_t*)blk0) != sb.checksum)
+            report("superblock checksum mismatch");
+        free(blk0);
+    }
+
+    const uint8_t* ibm = img + sb.inode_bitmap_start*bs;
+    const uint8_t* dbm = img + sb.data_bitmap_start*bs;
+    const inode_t* itbl = (const inode_t*)(img + sb.inode_table_start*bs);
+    uint64_t drs = sb.data_region_start, drb = sb.data_region_blocks;
+    const uint32_t* csum = (sb.flags & MVSF_FLAG_DATA_CSUM)
+        ? (const uint32_t*)(img + (sb.inode_table_start + sb.inode_table_blocks)*bs) : NULL;
+    if(csum && (drs - sb.inode_table_start - sb.inode_table_blocks) * (bs/4) < drb)
+        report("data checksum region covers fewer than %" PRIu64 " blocks", drb);
+
+    // -------- inodes --------
+    uint8_t* owner = (uint8_t*)calloc(drb ? drb : 1, 1);
+    if(!owner) die("calloc failed");
+    tail_ref_t* tails = (tail_ref_t*)malloc((sb.inode_count ? sb.inode_count : 1) * sizeof(tail_ref_t));
+    if(!tails) die("malloc failed");
+    uint64_t live = 0, ntails = 0;
+    if(!test_bit(ibm, 0)) report("root inode #%u not allocated", ROOT_INO);
+    for(uint64_t i=0;i<sb.inode_count;i++){
+        if(!test_bit(ibm, i)) continue;
+        live++;
+        inode_t node = itbl[i];
+        uint64_t stored = node.inode_crc;
+        inode_crc_finalize(&node);
+        if(node.inode_crc != stored) report("inode #%" PRIu64 ": checksum mismatch", i+1);
+        for(int k=0;k<DIRECT_MAX;k++){
+            uint32_t b = node.direct[k];
+            if(!b) continue;
+            if(b < drs || b >= drs + drb){ report("inode #%" PRIu64 ": block %" PRIu64 " outside data region", i+1, (uint64_t)b); continue; }
+            if(!test_bit(dbm, b - drs)) report("inode #%" PRIu64 ": block %" PRIu64 " not marked in data bitmap", i+1, (uint64_t)b);
+            if(owner[b - drs]++) report("inode #%" PRIu64 ": block %" PRIu64 " referenced twice", i+1, (uint64_t)b);
+        }
+        // packed tail: reserved_0 = fragment block, reserved_1 = offset, reserved_2 = length
+        uint32_t fb = node.reserved_0;
+        if(!fb) continue;
+        if(!(sb.flags & MVSF_FLAG_TAILPACK)) report("inode #%" PRIu64 ": packed tail but image lacks the tail-pack flag", i+1);
+        if(fb < drs || fb >= drs + drb){ report("inode #%" PRIu64 ": tail block %" PRIu64 " outside data region", i+1, (uint64_t)fb); continue; }
+        if(!test_bit(dbm, fb - drs)) report("inode #%" PRIu64 ": tail block %" PRIu64 " not marked in data bitmap", i+1, (uint64_t)fb);
+        if(node.reserved_2 == 0 || node.reserved_2 != node.size_bytes % bs || (uint64_t)node.reserved_1 + node.reserved_2 > bs)
+            report("inode #%" PRIu64 ": bad tail (offset %" PRIu32 ", length %" PRIu32 ")", i+1, node.reserved_1, node.reserved_2);
+        tails[ntails++] = (tail_ref_t){ fb, node.reserved_1, node.reserved_2, i+1 };
+    }
+
+    // -------- fragment blocks: shared by tails only, tails never overlap --------
+    qsort(tails, ntails, sizeof(tail_ref_t), tail_cmp);
+    for(uint64_t t=0;t<ntails;t++){
+        if((t == 0 || tails[t].block != tails[t-1].block) && owner[tails[t].block - drs])
+            report("block %" PRIu64 " is both a file block and a tail fragment", (uint64_t)tails[t].block);
+        if(t > 0 && tails[t].block == tails[t-1].block && tails[t-1].off + tails[t-1].len > tails[t].off)
+            report("tails of inodes #%" PRIu64 " and #%" PRIu64 " overlap in block %" PRIu64,
+                   tails[t-1].ino, tails[t].ino, (uint64_t)tails[t].block);
+    }
+
+    // -------- root directory --------
+    const inode_t* root = &itbl[0];
+    uint64_t dirents = 0;
+    for(int k=0;k<DIRECT_MAX;k++){
+        uint32_t b = root->direct[k];
+        if(b < drs || b >= drs + drb) continue;
+        const dirent64_t* ents = (const dirent64_t*)(img + (uint64_t)b*bs);
+        for(uint64_t e=0;e<bs/sizeof(dirent64_t);e++){
+            if(ents[e].inode_no == 0) continue;
+            dirents++;
+            dirent64_t de = ents[e];
+            dirent_checksum_finalize(&de);
+            if(de.checksum != ents[e].checksum) report("dirent %" PRIu64 " in block %" PRIu64 ": checksum mismatch", e, (uint64_t)b);
+            uint64_t ino = ents[e].inode_no;
+            if(ino > sb.inode_count || !test_bit(ibm, ino-1)) report("dirent %" PRIu64 ": inode #%" PRIu64 " not allocated", e, ino);
+        }
+    }
+
+    // -------- data blocks --------
+    uint64_t checked = 0;
+    if(csum && check_data) checked = check_data_blocks(bs, img, dbm, csum, drs, drb);
+
+    printf("Image: %s\n", image);
+    printf("Inodes in use: %" PRIu64 ", dirents: %" PRIu64 ", data blocks checked: %" PRIu64 "%s\n",
+           live, dirents, checked, csum ? "" : " (no data checksums)");
+    printf("%s (%" PRIu64 " error(s))\n", errors ? "FAILED" : "OK", errors);
+
+    free(owner);
+    free(tails);
+    munmap(img, (size_t)st.st_size);
+    return errors ? 1 : 0;
+}